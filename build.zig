@@ -11,25 +11,42 @@ pub fn build(b: *std.Build) void {
     };
 
     const clientTarget = b.standardTargetOptions(.{});
-
+    const hotPathsInIram = b.option(bool, "hotPathsInIram", "Place the hot paths of the control loop in IRAM/DRAM instead of flash (default: true).") orelse true;
+    const tachoStatistics = b.option(bool, "tachoStatistics", "Log the interrupts and the velocity noise of the tacho from a low priority task (default: false).") orelse false;
 
     const encodeModule = b.addModule("encode", .{ .root_source_file = b.path("shared/messageFormat/encode.zig") });
     const decodeModule = b.addModule("decode", .{ .root_source_file = b.path("shared/messageFormat/decode.zig") });
+    const encodeDecodeTestModule = b.addModule("encodeDecodeTest", .{ .root_source_file = b.path("shared/messageFormat/testEncodeDecode.zig") });
     const serverContractModule = b.addModule("encode", .{ .root_source_file = b.path("shared/serverContract.zig") });
     const clientContractModule = b.addModule("decode", .{ .root_source_file = b.path("shared/clientContract.zig") });
     const matrixModule = b.addModule("matrix", .{ .root_source_file = b.path("shared/matrix/matrix.zig") });
+    const placementOptions = b.addOptions();
+    placementOptions.addOption(bool, "hotPathsInIram", hotPathsInIram);
+    const placementModule = b.addModule("placement", .{ .root_source_file = b.path("shared/placement/placement.zig") });
+    placementModule.addOptions("placementOptions", placementOptions);
     const kdTreeModule = b.addModule("kdTree", .{ .root_source_file = b.path("shared/kdTree/kdTree.zig") });
+    kdTreeModule.addImport("placement", placementModule);
     const icpModule = b.addModule("icp", .{ .root_source_file = b.path("shared/icp/icp.zig") });
+    icpModule.addImport("kdTree", kdTreeModule);
     const trackModule = b.addModule("track", .{ .root_source_file = b.path("shared/track/track.zig") });
     trackModule.addImport("kdTree", kdTreeModule);
     trackModule.addImport("matrix", matrixModule);
+    trackModule.addImport("placement", placementModule);
+    trackModule.addImport("icp", icpModule);
     const configModule = b.addModule("config", .{ .root_source_file = b.path("shared/config/config.zig") });
+    const brakeLawModule = b.addModule("brakeLaw", .{ .root_source_file = b.path("shared/brakeLaw/brakeLaw.zig") });
+    brakeLawModule.addImport("config", configModule);
+    const particleFilterModule = b.addModule("particleFilter", .{ .root_source_file = b.path("shared/particleFilter/particleFilter.zig") });
+    particleFilterModule.addImport("track", trackModule);
+    particleFilterModule.addImport("placement", placementModule);
     const vectorModule = b.addModule("vector", .{ .root_source_file = b.path("shared/vector/vector.zig") });
     clientContractModule.addImport("vector", vectorModule);
     clientContractModule.addImport("track", trackModule);
+    clientContractModule.addImport("config", configModule);
     serverContractModule.addImport("config", configModule);
     serverContractModule.addImport("vector", vectorModule);
     const commandParserModule = b.addModule("commandParser", .{ .root_source_file = b.path("shared/commandParser/commandParser.zig") });
+    const spscQueueModule = b.addModule("spscQueue", .{ .root_source_file = b.path("shared/spscQueue/spscQueue.zig") });
 
     const clap = b.dependency("clap", .{});
 
@@ -49,10 +66,18 @@ pub fn build(b: *std.Build) void {
     controllerLib.root_module.addImport("serverContract", serverContractModule);
     controllerLib.root_module.addImport("clientContract", clientContractModule);
     controllerLib.root_module.addImport("icp", icpModule);
+    controllerLib.root_module.addImport("kdTree", kdTreeModule);
     controllerLib.root_module.addImport("track", trackModule);
     controllerLib.root_module.addImport("config", configModule);
+    controllerLib.root_module.addImport("brakeLaw", brakeLawModule);
+    controllerLib.root_module.addImport("placement", placementModule);
+    controllerLib.root_module.addImport("spscQueue", spscQueueModule);
+    controllerLib.root_module.addImport("particleFilter", particleFilterModule);
 
     controllerLib.root_module.addImport("commandParser", commandParserModule);
+    const tachoOptions = b.addOptions();
+    tachoOptions.addOption(bool, "tachoStatistics", tachoStatistics);
+    controllerLib.root_module.addOptions("tachoOptions", tachoOptions);
 
     controllerLib.addIncludePath(b.path("controller/c/"));
     controllerLib.addIncludePath(b.path("lib/BMI270_SensorAPI/"));
@@ -67,6 +92,8 @@ pub fn build(b: *std.Build) void {
                 "controller/c/bmi.c",
                 "controller/c/pwm.c",
                 "controller/c/pt.c",
+                "controller/c/pcnt.c",
+                "controller/c/serial.c",
             },
             .flags = &.{
                 "-fno-sanitize=undefined",
@@ -142,6 +169,8 @@ pub fn build(b: *std.Build) void {
     const raygui = raylib_dep.module("raygui");
     const raylib_artifact = raylib_dep.artifact("raylib");
     clientExe.linkLibrary(raylib_artifact);
+    // termios of the serial transport.
+    clientExe.linkLibC();
     clientExe.root_module.addImport("raylib", raylib);
     clientExe.root_module.addImport("raygui", raygui);
 
@@ -152,6 +181,7 @@ pub fn build(b: *std.Build) void {
     clientExe.root_module.addImport("clap", clap.module("clap"));
     clientExe.root_module.addImport("commandParser", commandParserModule);
     clientExe.root_module.addImport("track", trackModule);
+    clientExe.root_module.addImport("spscQueue", spscQueueModule);
 
     b.installArtifact(clientExe);
 
@@ -164,9 +194,35 @@ pub fn build(b: *std.Build) void {
     const runClientStep = b.step("runClient", "Run the client");
     runClientStep.dependOn(&runClientCmd.step);
 
+    const benchmarkDecodeExe = b.addExecutable(.{
+        .name = "benchmarkDecode",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("shared/messageFormat/benchmarkDecode.zig"),
+            .target = clientTarget,
+            .optimize = .ReleaseFast,
+        }),
+    });
+    const runBenchmarkDecodeCmd = b.addRunArtifact(benchmarkDecodeExe);
+    const benchmarkDecodeStep = b.step("benchmarkDecode", "Measure the throughput of the decoder over arbitrary chunking of the received bytes.");
+    benchmarkDecodeStep.dependOn(&runBenchmarkDecodeCmd.step);
+
+    const benchmarkReconstructionExe = b.addExecutable(.{
+        .name = "benchmarkReconstruction",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("shared/track/benchmarkReconstruction.zig"),
+            .target = clientTarget,
+            .optimize = .ReleaseFast,
+        }),
+    });
+    benchmarkReconstructionExe.root_module.addImport("track", trackModule);
+    const runBenchmarkReconstructionCmd = b.addRunArtifact(benchmarkReconstructionExe);
+    const benchmarkReconstructionStep = b.step("benchmarkReconstruction", "Compare the vectorized reconstruction of the track positions with the sequential one.");
+    benchmarkReconstructionStep.dependOn(&runBenchmarkReconstructionCmd.step);
+
     const toUnitTestModules = [_]*std.Build.Module{
         encodeModule,
         decodeModule,
+        encodeDecodeTestModule,
         serverContractModule,
         clientContractModule,
         matrixModule,
@@ -174,8 +230,11 @@ pub fn build(b: *std.Build) void {
         icpModule,
         trackModule,
         configModule,
+        brakeLawModule,
         vectorModule,
         commandParserModule,
+        spscQueueModule,
+        particleFilterModule,
         clientExe.root_module,
     };
 
@@ -213,4 +272,12 @@ pub fn build(b: *std.Build) void {
     const flashStep = b.step("flash", "Build the zig library, the final image and flash the image onto the esp.");
     flashStep.dependOn(buildIdfStep);
     flashStep.dependOn(&flashCmd.step);
+
+    const sizeFilesCmd = b.addSystemCommand(&[_][]const u8{ "idf.py", "size-files" });
+    sizeFilesCmd.step.dependOn(buildIdfStep);
+    const placementMapCmd = b.addSystemCommand(&[_][]const u8{ "sh", "-c", "grep -A1 -E '^ \\.iram1\\.asc\\.' build/idfProject.map" });
+    placementMapCmd.step.dependOn(&sizeFilesCmd.step);
+
+    const placementReportStep = b.step("placementReport", "Build the final image and report the IRAM/DRAM usage and where the hot paths were placed.");
+    placementReportStep.dependOn(&placementMapCmd.step);
 }
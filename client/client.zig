@@ -1,7 +1,9 @@
 const std = @import("std");
 const net = std.net;
 
-const NetClient = @import("netClient.zig").NetClient;
+const NetThread = @import("netThread.zig").NetThread;
+const ClockSync = @import("clockSync.zig").ClockSync;
+const LatencyView = @import("latencyView.zig").LatencyView;
 const guiApi = @import("gui.zig");
 const Gui = guiApi.Gui;
 const clientContract = @import("clientContract");
@@ -23,49 +25,54 @@ const commandParserT: type = CommandParser(serverContract.command, descriptions)
 
 pub const Client = struct {
     allocator: std.mem.Allocator,
-    netClient: NetClientT,
+    netThread: *NetThread,
     gui: Gui,
-    file: std.fs.File,
-    trackFile: std.fs.File,
     trackPoints: std.ArrayList(TrackPoint),
     prevPosition: rl.Vector2,
     track: ?Track,
+    // Synthetic setSpeed commands sent every frame, the controller logs the latency until they are applied.
+    floodCommandsPerFrame: u32,
+    lastPingMicros: i64,
+    // The last reported position of the car, it is extrapolated to the time of every frame.
+    carTrackPoint: ?clientContract.CarTrackPoint,
+    // Set by the signal handler of SIGINT, run returns at the next frame.
+    stopRequested: *const std.atomic.Value(bool),
 
     const Self = @This();
-    const NetClientT = NetClient(clientContract.ClientContractEnum, clientContract.ClientContract, Self, serverContract.ServerContract);
-
-    pub fn init(allocator: std.mem.Allocator, netClient: NetClientT) !Self {
-        const file = try std.fs.cwd().createFile(
-            "measurement.csv",
-            .{},
-        );
-        try file.writeAll("time,heading,accelerationX,accelerationY,accelerationZ,velocity,distance\n");
-
-        const trackFile = try std.fs.cwd().createFile(
-            "track.csv",
-            .{},
-        );
-        try trackFile.writeAll("distance,heading\n");
-        const gui = try Gui.init(allocator);
+    const pingIntervalMicros = 500 * std.time.us_per_ms;
+    // If the car track points stop, the car isn't moved further than this.
+    const maxExtrapolationMicros = 200 * std.time.us_per_ms;
+
+    pub fn init(allocator: std.mem.Allocator, netThread: *NetThread, stopRequested: *const std.atomic.Value(bool)) !Self {
+        var gui = try Gui.init(allocator);
+        gui.latencyView = LatencyView.init(&netThread.clockSync, &netThread.latencies, netThread.linkName());
 
         return .{
             .allocator = allocator,
-            .netClient = netClient,
+            .netThread = netThread,
             .gui = gui,
-            .file = file,
-            .trackFile = trackFile,
             .trackPoints = try std.ArrayList(TrackPoint).initCapacity(allocator, 10),
             .prevPosition = rl.Vector2.init(0, 0),
             .track = null,
+            .floodCommandsPerFrame = 0,
+            .lastPingMicros = 0,
+            .carTrackPoint = null,
+            .stopRequested = stopRequested,
         };
     }
 
     pub fn run(self: *Self) !void {
-        while (true) {
-            self.netClient.recv() catch |err| switch (err) {
-                error.ConnectionClosed => return,
-                else => return err,
-            };
+        while (!self.stopRequested.load(.acquire)) {
+            // Read the status before draining, so the last messages before the connection closed are still handled.
+            const status = self.netThread.getStatus();
+            try self.handleMessages();
+            switch (status) {
+                .running => {},
+                .connectionClosed, .stopped => return,
+                .failed => return error.NetThreadFailed,
+            }
+            try self.ping();
+            self.updateCarPosition();
 
             self.gui.update() catch |err| switch (err) {
                 guiApi.GuiError.Quit => return,
@@ -90,7 +97,12 @@ pub const Client = struct {
                     continue;
                 };
 
-                try self.netClient.send(serverContract.command, command);
+                try self.netThread.send(serverContract.command, command);
+            }
+
+            for (0..self.floodCommandsPerFrame) |_| {
+                const command: serverContract.command = serverContract.command{ .setSpeed = serverContract.setSpeed{ .speed = 0.0 } };
+                try self.netThread.send(serverContract.command, command);
             }
 
             const deadzone: f32 = 0.05;
@@ -122,41 +134,56 @@ pub const Client = struct {
                 const command: serverContract.command = serverContract.command{ .setSpeed = serverContract.setSpeed{
                     .speed = (stick.y + 1.0) / 2.0,
                 } };
-                try self.netClient.send(serverContract.command, command);
+                try self.netThread.send(serverContract.command, command);
+            }
+        }
+    }
+
+    /// Handles the messages the network thread decoded since the last frame.
+    fn handleMessages(self: *Self) !void {
+        while (self.netThread.messages.pop()) |message| {
+            switch (message) {
+                .measurement => |measurement| try self.handleMeasurement(measurement),
+                .trackPoint => |trackPoint| try self.handleTrackPoint(trackPoint),
+                .carTrackPoint => |carTrackPoint| try self.handleCarTrackPoint(carTrackPoint),
+                .log => |log| try self.handleLog(log),
+                .command => |command| try self.handleCommand(command),
+                .configSnapshot => |config| try self.handleConfigSnapshot(config),
+                .headingSample => |headingSample| try self.handleHeadingSample(headingSample),
+                .accelerationSample => |accelerationSample| try self.handleAccelerationSample(accelerationSample),
+                // Handled by the network thread.
+                .pong => {},
             }
         }
     }
 
     pub fn handleMeasurement(self: *Self, measurement: clientContract.Measurement) !void {
-        const buffer = try std.fmt.allocPrint(
-            self.allocator,
-            "{d},{d},{d},{d},{d},{d},{d}\n",
-            .{ measurement.time, measurement.heading, measurement.accelerationX, measurement.accelerationY, measurement.accelerationZ, measurement.velocity, measurement.distance },
-        );
-        try self.file.writeAll(buffer);
-        self.allocator.free(buffer);
-
-        var array = [_]rl.Vector2{rl.Vector2.init(measurement.time, measurement.heading)};
+        try self.handleHeadingSample(.{ .time = measurement.time, .heading = measurement.heading });
+        try self.handleAccelerationSample(.{
+            .time = measurement.time,
+            .accelerationX = measurement.accelerationX,
+            .accelerationY = measurement.accelerationY,
+            .accelerationZ = measurement.accelerationZ,
+        });
+    }
+
+    pub fn handleHeadingSample(self: *Self, headingSample: clientContract.HeadingSample) !void {
+        const array = [_]rl.Vector2{rl.Vector2.init(headingSample.time, headingSample.heading)};
         try self.gui.addPoints("Yaw", "Heading", &array);
+    }
 
-        array[0] = rl.Vector2.init(measurement.time, measurement.accelerationX);
+    pub fn handleAccelerationSample(self: *Self, accelerationSample: clientContract.AccelerationSample) !void {
+        var array = [_]rl.Vector2{rl.Vector2.init(accelerationSample.time, accelerationSample.accelerationX)};
         try self.gui.addPoints("Acceleration", "Acceleration x", &array);
 
-        array[0] = rl.Vector2.init(measurement.time, measurement.accelerationY);
+        array[0] = rl.Vector2.init(accelerationSample.time, accelerationSample.accelerationY);
         try self.gui.addPoints("Acceleration", "Acceleration y", &array);
 
-        array[0] = rl.Vector2.init(measurement.time, measurement.accelerationZ);
+        array[0] = rl.Vector2.init(accelerationSample.time, accelerationSample.accelerationZ);
         try self.gui.addPoints("Acceleration", "Acceleration z", &array);
     }
 
     pub fn handleTrackPoint(self: *Self, trackPoint: clientContract.TrackPoint) !void {
-        const buffer = try std.fmt.allocPrint(
-            self.allocator,
-            "{d},{d}\n",
-            .{ trackPoint.distance, trackPoint.heading },
-        );
-        try self.trackFile.writeAll(buffer);
-        self.allocator.free(buffer);
         try self.trackPoints.append(self.allocator, .{ .distance = trackPoint.distance, .heading = trackPoint.heading});
 
         if (self.trackPoints.items.len <= 1) {
@@ -183,10 +210,34 @@ pub const Client = struct {
     }
 
     pub fn handleCarTrackPoint(self: *Self, trackPoint: clientContract.CarTrackPoint) !void {
-        if (self.track) |track| {
-            const position = track.distanceToPosition(trackPoint.distance);
-            self.gui.carPositionAndHeading = .{ .position = .{ .x = position.x, .y = position.y }, .heading = trackPoint.heading };
+        self.carTrackPoint = trackPoint;
+    }
+
+    /// Pings the controller regularly, the network thread estimates the clock offset from the pongs.
+    fn ping(self: *Self) !void {
+        const now = ClockSync.nowMicros();
+        if (now - self.lastPingMicros < pingIntervalMicros) {
+            return;
         }
+        self.lastPingMicros = now;
+        try self.netThread.send(serverContract.command, .{ .ping = .{ .clientMicros = now } });
+    }
+
+    /// Moves the car from where the controller reported it to where it is now, with its velocity and the age
+    /// of the report. Until the clock offset is known, the car is drawn where it was reported.
+    fn updateCarPosition(self: *Self) void {
+        const track = if (self.track) |*track| track else return;
+        const trackPoint = self.carTrackPoint orelse return;
+        var distance = @mod(trackPoint.distance, track.getTrackLength());
+        var heading = trackPoint.heading;
+        if (self.netThread.clockSync.ageMicros(trackPoint.deviceMicros)) |ageMicros| {
+            const ageS = @as(f32, @floatFromInt(std.math.clamp(ageMicros, 0, maxExtrapolationMicros))) / std.time.us_per_s;
+            const extrapolated = @mod(distance + trackPoint.velocity * ageS, track.getTrackLength());
+            heading = @mod(heading + Track.angularDelta(track.distanceToHeading(distance), track.distanceToHeading(extrapolated)), 360.0);
+            distance = extrapolated;
+        }
+        const position = track.distanceToPosition(distance);
+        self.gui.carPositionAndHeading = .{ .position = .{ .x = position.x, .y = position.y }, .heading = heading };
     }
 
     pub fn handleLog(self: *Self, log: clientContract.Log) !void {
@@ -205,6 +256,26 @@ pub const Client = struct {
         try self.gui.writeToConsole(text.items);
     }
 
+    /// Prints the config as an applyConfig command and appends it to config.txt,
+    /// so a config can be restored or switched with a single command.
+    pub fn handleConfigSnapshot(self: *Self, config: clientContract.ConfigSnapshot) !void {
+        var text = try std.ArrayList(u8).initCapacity(self.allocator, 512);
+        defer text.deinit(self.allocator);
+        try text.appendSlice(self.allocator, "applyConfig");
+        inline for (@typeInfo(clientContract.ConfigSnapshot).@"struct".fields) |field| {
+            const option = try std.fmt.allocPrint(self.allocator, " --{s} {d}", .{ field.name, @field(config, field.name) });
+            defer self.allocator.free(option);
+            try text.appendSlice(self.allocator, option);
+        }
+        try text.append(self.allocator, '\n');
+        try self.gui.writeToConsole(text.items);
+
+        const configFile = try std.fs.cwd().createFile("config.txt", .{ .truncate = false });
+        defer configFile.close();
+        try configFile.seekFromEnd(0);
+        try configFile.writeAll(text.items);
+    }
+
     pub fn handleCommand(self: *Self, command: clientContract.command) !void {
         switch (command) {
             .endMapping => {
@@ -231,9 +302,7 @@ pub const Client = struct {
     }
 
     pub fn deinit(self: *Self) void {
-        self.netClient.deinit();
         self.gui.deinit();
-        self.file.close();
         self.trackPoints.deinit(self.allocator);
         if (self.track) |*track| {
             track.deinit();
@@ -0,0 +1,78 @@
+const std = @import("std");
+
+const clientContract = @import("clientContract");
+
+/// Estimates the offset of the clock of the controller to the clock of the client from ping and pong, like NTP.
+/// With t0 the ping sent and t3 the pong received on the client, and t1 the ping received and t2 the pong sent on the
+/// controller, the round trip time is (t3 - t0) - (t2 - t1) and the offset ((t1 - t0) + (t2 - t3)) / 2.
+/// The offset of the sample with the shortest round trip time out of the last sampleCount is used,
+/// it was delayed the least by queues on the way, which is the largest error of the offset.
+/// Updated by the network thread, read by the gui thread.
+pub const ClockSync = struct {
+    const Self = @This();
+    const sampleCount = 8;
+
+    const Sample = struct {
+        offsetMicros: i64,
+        roundTripMicros: i64,
+    };
+
+    samples: [sampleCount]Sample,
+    count: usize,
+    next: usize,
+    offsetMicros: std.atomic.Value(i64),
+    roundTripMicros: std.atomic.Value(i64),
+    synchronized: std.atomic.Value(bool),
+
+    pub fn init() Self {
+        return .{
+            .samples = undefined,
+            .count = 0,
+            .next = 0,
+            .offsetMicros = std.atomic.Value(i64).init(0),
+            .roundTripMicros = std.atomic.Value(i64).init(0),
+            .synchronized = std.atomic.Value(bool).init(false),
+        };
+    }
+
+    pub fn nowMicros() i64 {
+        return std.time.microTimestamp();
+    }
+
+    pub fn addPong(self: *Self, pong: clientContract.Pong, receivedMicros: i64) void {
+        const roundTripMicros = (receivedMicros - pong.clientMicros) - (pong.deviceSendMicros - pong.deviceReceiveMicros);
+        if (roundTripMicros < 0) {
+            return;
+        }
+        self.samples[self.next] = .{
+            .offsetMicros = @divFloor((pong.deviceReceiveMicros - pong.clientMicros) + (pong.deviceSendMicros - receivedMicros), 2),
+            .roundTripMicros = roundTripMicros,
+        };
+        self.next = (self.next + 1) % sampleCount;
+        self.count = @min(self.count + 1, sampleCount);
+
+        var best = self.samples[0];
+        for (self.samples[1..self.count]) |sample| {
+            if (sample.roundTripMicros < best.roundTripMicros) {
+                best = sample;
+            }
+        }
+        self.offsetMicros.store(best.offsetMicros, .release);
+        self.roundTripMicros.store(best.roundTripMicros, .release);
+        self.synchronized.store(true, .release);
+    }
+
+    /// The time on the client when the controller had the time deviceMicros, null until the first pong.
+    pub fn toClientMicros(self: *const Self, deviceMicros: i64) ?i64 {
+        if (!self.synchronized.load(.acquire)) {
+            return null;
+        }
+        return deviceMicros - self.offsetMicros.load(.acquire);
+    }
+
+    /// How long ago the controller had the time deviceMicros, null until the first pong.
+    pub fn ageMicros(self: *const Self, deviceMicros: i64) ?i64 {
+        const clientMicros = self.toClientMicros(deviceMicros) orelse return null;
+        return nowMicros() - clientMicros;
+    }
+};
@@ -0,0 +1,110 @@
+const std = @import("std");
+
+const clientContract = @import("clientContract");
+const SpscQueue = @import("spscQueue").SpscQueue;
+
+pub const Record = union(enum) {
+    measurement: clientContract.Measurement,
+    trackPoint: clientContract.TrackPoint,
+};
+
+pub const RecordQueue = SpscQueue(Record, 4096);
+
+/// Writes the measurements and track points to measurement.csv and track.csv on its own thread,
+/// so neither the network thread nor the gui waits on the disk.
+pub const FileWriter = struct {
+    const Self = @This();
+    const idleSleepNs = 10 * std.time.ns_per_ms;
+
+    records: RecordQueue,
+    measurementFile: std.fs.File,
+    trackFile: std.fs.File,
+    running: std.atomic.Value(bool),
+    thread: ?std.Thread,
+
+    /// self has to stay at the same address because the network thread pushes into its queue.
+    pub fn init(self: *Self) !void {
+        const measurementFile = try std.fs.cwd().createFile(
+            "measurement.csv",
+            .{},
+        );
+        errdefer measurementFile.close();
+        try measurementFile.writeAll("time,heading,accelerationX,accelerationY,accelerationZ,velocity,distance\n");
+
+        const trackFile = try std.fs.cwd().createFile(
+            "track.csv",
+            .{},
+        );
+        errdefer trackFile.close();
+        try trackFile.writeAll("distance,heading\n");
+
+        self.* = .{
+            .records = RecordQueue.init(),
+            .measurementFile = measurementFile,
+            .trackFile = trackFile,
+            .running = std.atomic.Value(bool).init(true),
+            .thread = null,
+        };
+    }
+
+    pub fn start(self: *Self) !void {
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+    /// Called by the network thread. Waits if the writer fell behind by a whole queue.
+    pub fn push(self: *Self, record: Record) void {
+        while (!self.records.push(record)) {
+            if (!self.running.load(.acquire)) {
+                return;
+            }
+            std.Thread.sleep(std.time.ns_per_ms);
+        }
+    }
+
+    fn run(self: *Self) void {
+        self.write() catch |err| {
+            std.log.err("Writing the measurement files failed: {s}\n", .{@errorName(err)});
+        };
+    }
+
+    fn write(self: *Self) !void {
+        var measurementBuffer: [4096]u8 = undefined;
+        var measurementFileWriter = self.measurementFile.writer(&measurementBuffer);
+        const measurementWriter = &measurementFileWriter.interface;
+        var trackBuffer: [1024]u8 = undefined;
+        var trackFileWriter = self.trackFile.writer(&trackBuffer);
+        const trackWriter = &trackFileWriter.interface;
+
+        while (true) {
+            // Read running before draining, so nothing pushed before stop is lost.
+            const running = self.running.load(.acquire);
+            while (self.records.pop()) |record| {
+                switch (record) {
+                    .measurement => |measurement| try measurementWriter.print(
+                        "{d},{d},{d},{d},{d},{d},{d}\n",
+                        .{ measurement.time, measurement.heading, measurement.accelerationX, measurement.accelerationY, measurement.accelerationZ, measurement.velocity, measurement.distance },
+                    ),
+                    .trackPoint => |trackPoint| try trackWriter.print("{d},{d}\n", .{ trackPoint.distance, trackPoint.heading }),
+                }
+            }
+            // Flushed whenever the queue is empty, so the files are at most one idle period behind.
+            try measurementWriter.flush();
+            try trackWriter.flush();
+            if (!running) {
+                return;
+            }
+            std.Thread.sleep(idleSleepNs);
+        }
+    }
+
+    /// Writes everything which is still queued and closes the files.
+    pub fn deinit(self: *Self) void {
+        self.running.store(false, .release);
+        if (self.thread) |thread| {
+            thread.join();
+            self.thread = null;
+        }
+        self.measurementFile.close();
+        self.trackFile.close();
+    }
+};
@@ -8,6 +8,7 @@ const DataSet = p.DataSet;
 const c = @import("console.zig");
 const Console = c.Console;
 const TrackMapPlot = @import("trackMapPlot.zig").TrackMapPlot;
+const LatencyView = @import("latencyView.zig").LatencyView;
 
 pub const GuiError = error{
     UnkownDataSetName,
@@ -28,6 +29,7 @@ pub const Gui = struct {
     trackMapPlot: TrackMapPlot,
     console: Console,
     carPositionAndHeading: ?PositionAndHeading,
+    latencyView: ?LatencyView,
 
     pub fn init(allocator: std.mem.Allocator) !Self {
         const windowWidth = rl.getScreenWidth();
@@ -63,7 +65,7 @@ pub const Gui = struct {
 
         const console = try Console.init(allocator, rl.Vector2.init(0.5, 0.5), rl.Vector2.init(0.5, 0.5), 0, windowWidthF, windowHeightF);
 
-        return .{ .allocator = allocator, .plots = plots, .console = console, .trackMapPlot = trackMapPlot, .carPositionAndHeading = null };
+        return .{ .allocator = allocator, .plots = plots, .console = console, .trackMapPlot = trackMapPlot, .carPositionAndHeading = null, .latencyView = null };
     }
 
     pub fn update(self: *Self) !void {
@@ -90,6 +92,12 @@ pub const Gui = struct {
         if (self.carPositionAndHeading) |carPositionAndHeading| {
             self.trackMapPlot.drawCar(carPositionAndHeading.heading, carPositionAndHeading.position);
         }
+        if (self.latencyView) |*latencyView| {
+            if (rl.isKeyPressed(.f3)) {
+                latencyView.visible = !latencyView.visible;
+            }
+            latencyView.draw(self.trackMapPlot.plot.topLeft);
+        }
 
         try self.console.resize(windowWidth, windowHeight);
         try self.console.update();
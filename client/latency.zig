@@ -0,0 +1,65 @@
+const std = @import("std");
+
+/// The telemetry streams whose age on arrival is measured.
+pub const Stream = enum {
+    measurement,
+    headingSample,
+    accelerationSample,
+    carTrackPoint,
+};
+
+/// Counts latencies into buckets up to bucketUpperMs, the last bucket counts everything above.
+/// Recorded by the network thread, read by the gui thread.
+pub const LatencyHistogram = struct {
+    const Self = @This();
+    pub const bucketUpperMs = [_]i64{ 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+    pub const bucketCount = bucketUpperMs.len + 1;
+
+    counts: [bucketCount]std.atomic.Value(u32),
+
+    pub fn init() Self {
+        var self: Self = undefined;
+        for (&self.counts) |*count| {
+            count.* = std.atomic.Value(u32).init(0);
+        }
+        return self;
+    }
+
+    pub fn record(self: *Self, latencyMicros: i64) void {
+        var bucket: usize = 0;
+        while (bucket < bucketUpperMs.len and latencyMicros > bucketUpperMs[bucket] * std.time.us_per_ms) {
+            bucket += 1;
+        }
+        _ = self.counts[bucket].fetchAdd(1, .monotonic);
+    }
+
+    pub fn snapshot(self: *const Self) [bucketCount]u32 {
+        var counts: [bucketCount]u32 = undefined;
+        for (&counts, &self.counts) |*count, *atomicCount| {
+            count.* = atomicCount.load(.monotonic);
+        }
+        return counts;
+    }
+};
+
+pub const StreamLatencies = struct {
+    const Self = @This();
+
+    histograms: [@typeInfo(Stream).@"enum".fields.len]LatencyHistogram,
+
+    pub fn init() Self {
+        var self: Self = undefined;
+        for (&self.histograms) |*histogram| {
+            histogram.* = LatencyHistogram.init();
+        }
+        return self;
+    }
+
+    pub fn record(self: *Self, stream: Stream, latencyMicros: i64) void {
+        self.histograms[@intFromEnum(stream)].record(latencyMicros);
+    }
+
+    pub fn get(self: *const Self, stream: Stream) *const LatencyHistogram {
+        return &self.histograms[@intFromEnum(stream)];
+    }
+};
@@ -0,0 +1,84 @@
+const std = @import("std");
+
+const rl = @import("raylib");
+
+const ClockSync = @import("clockSync.zig").ClockSync;
+const latency = @import("latency.zig");
+const LatencyHistogram = latency.LatencyHistogram;
+const StreamLatencies = latency.StreamLatencies;
+
+/// Draws the round trip time, the clock offset and a histogram of the age on arrival of every telemetry stream.
+/// The header names the link, so runs over tcp and serial can be compared.
+/// It is toggled with F3 and only costs something while it is shown.
+pub const LatencyView = struct {
+    const Self = @This();
+
+    const fontSize: i32 = 12;
+    const rowHeight: f32 = 34.0;
+    const nameWidth: f32 = 130.0;
+    const barWidth: f32 = 28.0;
+    const barHeight: f32 = 24.0;
+    const padding: f32 = 8.0;
+    var array: [64]u8 = undefined;
+
+    clockSync: *const ClockSync,
+    latencies: *const StreamLatencies,
+    linkName: [:0]const u8,
+    visible: bool,
+
+    pub fn init(clockSync: *const ClockSync, latencies: *const StreamLatencies, linkName: [:0]const u8) Self {
+        return .{ .clockSync = clockSync, .latencies = latencies, .linkName = linkName, .visible = false };
+    }
+
+    pub fn draw(self: Self, topLeft: rl.Vector2) void {
+        if (!self.visible) {
+            return;
+        }
+        const streamCount = @typeInfo(latency.Stream).@"enum".fields.len;
+        const width = nameWidth + barWidth * LatencyHistogram.bucketCount + 2 * padding;
+        const height = rowHeight * (streamCount + 2) + 2 * padding;
+        rl.drawRectangleV(topLeft, rl.Vector2.init(width, height), rl.fade(rl.Color.white, 0.9));
+        rl.drawRectangleLinesEx(.{ .x = topLeft.x, .y = topLeft.y, .width = width, .height = height }, 1.0, rl.Color.black);
+
+        const x = topLeft.x + padding;
+        var y = topLeft.y + padding;
+        const header = if (self.clockSync.synchronized.load(.acquire))
+            std.fmt.bufPrintZ(&array, "{s}: round trip {d:.1} ms, offset {d:.1} ms", .{
+                self.linkName,
+                toMs(self.clockSync.roundTripMicros.load(.acquire)),
+                toMs(self.clockSync.offsetMicros.load(.acquire)),
+            }) catch unreachable
+        else
+            std.fmt.bufPrintZ(&array, "{s}: waiting for the first pong", .{self.linkName}) catch unreachable;
+        rl.drawText(header, @intFromFloat(x), @intFromFloat(y), fontSize, rl.Color.black);
+        y += rowHeight;
+
+        inline for (@typeInfo(latency.Stream).@"enum".fields) |field| {
+            rl.drawText(field.name, @intFromFloat(x), @intFromFloat(y + barHeight - @as(f32, fontSize)), fontSize, rl.Color.black);
+            const counts = self.latencies.get(@enumFromInt(field.value)).snapshot();
+            const maxCount = std.mem.max(u32, &counts);
+            for (counts, 0..) |count, bucket| {
+                const fraction: f32 = if (maxCount == 0) 0.0 else @as(f32, @floatFromInt(count)) / @as(f32, @floatFromInt(maxCount));
+                const bucketF: f32 = @floatFromInt(bucket);
+                const barX = x + nameWidth + bucketF * barWidth;
+                rl.drawRectangleV(rl.Vector2.init(barX, y + barHeight * (1.0 - fraction)), rl.Vector2.init(barWidth - 2.0, barHeight * fraction), rl.Color.dark_blue);
+            }
+            y += rowHeight;
+        }
+
+        // Upper bound of every bucket under its bar.
+        for (0..LatencyHistogram.bucketCount) |bucket| {
+            const bucketF: f32 = @floatFromInt(bucket);
+            const label = if (bucket < LatencyHistogram.bucketUpperMs.len)
+                std.fmt.bufPrintZ(&array, "{d}", .{LatencyHistogram.bucketUpperMs[bucket]}) catch unreachable
+            else
+                std.fmt.bufPrintZ(&array, "more", .{}) catch unreachable;
+            rl.drawText(label, @intFromFloat(x + nameWidth + bucketF * barWidth), @intFromFloat(y), fontSize, rl.Color.black);
+        }
+        rl.drawText("ms", @intFromFloat(x), @intFromFloat(y), fontSize, rl.Color.black);
+    }
+
+    fn toMs(micros: i64) f32 {
+        return @as(f32, @floatFromInt(micros)) / std.time.us_per_ms;
+    }
+};
@@ -4,23 +4,26 @@ const os = std.os;
 const clap = @import("clap");
 
 const Client = @import("client.zig").Client;
-const NetClient = @import("netClient.zig").NetClient;
+const netThreadMod = @import("netThread.zig");
+const NetThread = netThreadMod.NetThread;
+const FileWriter = @import("fileWriter.zig").FileWriter;
 const clientContract = @import("clientContract");
 const serverContract = @import("serverContract");
 
 var client: Client = undefined;
-var isClientCreated: bool = false;
+var netThread: NetThread = undefined;
+var fileWriter: FileWriter = undefined;
+var stopRequested = std.atomic.Value(bool).init(false);
 
+/// Only sets the flag, Client.run returns when it sees it and main cleans up with its defers.
+/// Joining the threads or freeing memory here could deadlock if the signal interrupted a thread holding the allocator.
+/// A second signal exits right away, for example while connecting, before the client runs.
 pub fn sigIntHandler(sig: c_int) callconv(.c) void {
     _ = sig;
 
-    std.log.warn("Received signal to exit.\n", .{});
-
-    if (isClientCreated) {
-        client.deinit();
+    if (stopRequested.swap(true, .acq_rel)) {
+        os.linux.exit_group(1);
     }
-
-    std.process.exit(1);
 }
 
 pub fn main() !void {
@@ -31,6 +34,9 @@ pub fn main() !void {
         \\-h, --help            Display this help and exit.
         \\-s, --server <str>    Hostname of the server to connect to.
         \\-p, --port <u16>      Port of the server to connect to.
+        \\-d, --device <str>    Serial port to connect over instead of tcp, for a controller with the serial transport.
+        \\-b, --baud <u32>      Baud rate of the serial port, 2000000 by default.
+        \\-f, --flood <u32>     Send this many setSpeed commands with speed 0 every frame, to measure the command latency.
     );
 
     var diag = clap.Diagnostic{};
@@ -63,15 +69,24 @@ pub fn main() !void {
     if (res.args.port) |argPort| {
         port = argPort;
     }
-    const netClient = try NetClient(clientContract.ClientContractEnum, clientContract.ClientContract, Client, serverContract.ServerContract).init(
-        gpa.allocator(),
-        hostname,
-        port,
-        &client,
-    );
-    client = try Client.init(gpa.allocator(), netClient);
-    isClientCreated = true;
+    try fileWriter.init();
+    defer fileWriter.deinit();
+    var endpoint: netThreadMod.Endpoint = .{ .tcp = .{ .hostname = hostname, .port = port } };
+    if (res.args.device) |device| {
+        endpoint = .{ .serial = .{ .path = device, .baudRate = res.args.baud orelse 2_000_000 } };
+    }
+    try netThread.init(gpa.allocator(), endpoint, &fileWriter);
+    defer netThread.deinit();
+    client = try Client.init(gpa.allocator(), &netThread, &stopRequested);
+    if (res.args.flood) |flood| {
+        client.floodCommandsPerFrame = flood;
+    }
     defer client.deinit();
+    try fileWriter.start();
+    try netThread.start();
 
     try client.run();
+    if (stopRequested.load(.acquire)) {
+        std.log.warn("Received signal to exit.\n", .{});
+    }
 }
@@ -6,7 +6,8 @@ const posix = std.posix;
 const decode = @import("decode");
 const encode = @import("encode");
 
-pub fn NetClient(comptime clientContractEnumT: type, comptime clientContractT: type, comptime handlerT: type, comptime serverContract: type) type {
+/// receiveBufferSize is the most that is read from the socket at once, recv reads until the socket would block.
+pub fn NetClient(comptime clientContractEnumT: type, comptime clientContractT: type, comptime handlerT: type, comptime serverContract: type, comptime receiveBufferSize: usize) type {
     return struct {
         allocator: std.mem.Allocator,
         socket: posix.socket_t,
@@ -16,7 +17,7 @@ pub fn NetClient(comptime clientContractEnumT: type, comptime clientContractT: t
         const Encoder = encode.Encoder(serverContract);
 
         const Self = @This();
-        var buffer: [128]u8 = undefined;
+        var buffer: [receiveBufferSize]u8 = undefined;
 
         pub fn init(allocator: std.mem.Allocator, hostname: []const u8, port: u16, handler: *handlerT) !Self {
             const addressList = try net.getAddressList(allocator, hostname, port);
@@ -98,15 +99,18 @@ pub fn NetClient(comptime clientContractEnumT: type, comptime clientContractT: t
             return .{ .allocator = allocator, .socket = socket, .stream = stream, .decoder = decoder };
         }
 
+        /// Reads and decodes until there is nothing left on the socket, so telemetry doesn't lag behind by more than a frame.
         pub fn recv(self: *Self) !void {
-            const bytesRead = self.stream.read(&buffer) catch |err| switch (err) {
-                error.WouldBlock => return,
-                else => return err,
-            };
-            if (bytesRead == 0) {
-                return error.ConnectionClosed;
+            while (true) {
+                const bytesRead = self.stream.read(&buffer) catch |err| switch (err) {
+                    error.WouldBlock => return,
+                    else => return err,
+                };
+                if (bytesRead == 0) {
+                    return error.ConnectionClosed;
+                }
+                try self.decoder.decode(buffer[0..bytesRead]);
             }
-            try self.decoder.decode(buffer[0..bytesRead]);
         }
 
         pub fn send(self: Self, comptime T: type, message: T) !void {
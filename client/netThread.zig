@@ -0,0 +1,211 @@
+const std = @import("std");
+const posix = std.posix;
+
+const NetClient = @import("netClient.zig").NetClient;
+const SerialClient = @import("serialClient.zig").SerialClient;
+const FileWriter = @import("fileWriter.zig").FileWriter;
+const clientContract = @import("clientContract");
+const serverContract = @import("serverContract");
+const SpscQueue = @import("spscQueue").SpscQueue;
+const ClockSync = @import("clockSync.zig").ClockSync;
+const latency = @import("latency.zig");
+const StreamLatencies = latency.StreamLatencies;
+
+pub const MessageQueue = SpscQueue(clientContract.ClientContract, 4096);
+
+pub const NetStatus = enum(u8) {
+    running,
+    connectionClosed,
+    failed,
+    stopped,
+};
+
+pub const Endpoint = union(enum) {
+    tcp: struct { hostname: []const u8, port: u16 },
+    serial: struct { path: []const u8, baudRate: u32 },
+};
+
+/// Receives and decodes the messages of the controller on its own thread, so a slow frame doesn't back up the socket
+/// and stall the controller while it sends.
+/// Decoded messages are queued for the gui, which drains the queue every frame.
+/// Measurements and track points are additionally handed to the file writer.
+/// Sending stays on the gui thread, only the gui thread encodes.
+/// Pongs are handled here, so the time they are received at isn't delayed by a frame,
+/// and the age of every telemetry message on arrival is counted into the latency histograms.
+pub const NetThread = struct {
+    const Self = @This();
+    const receiveBufferSize = 4096;
+    const pollTimeoutMs = 100;
+    pub const NetClientT = NetClient(clientContract.ClientContractEnum, clientContract.ClientContract, Self, serverContract.ServerContract, receiveBufferSize);
+    pub const SerialClientT = SerialClient(clientContract.ClientContractEnum, clientContract.ClientContract, Self, serverContract.ServerContract, receiveBufferSize);
+
+    /// The client of the transport the controller was booted with, both decode into the network thread.
+    const Link = union(enum) {
+        tcp: NetClientT,
+        serial: SerialClientT,
+
+        fn fd(self: *const Link) posix.fd_t {
+            return switch (self.*) {
+                inline else => |*client| client.socket,
+            };
+        }
+
+        fn recv(self: *Link) !void {
+            switch (self.*) {
+                inline else => |*client| try client.recv(),
+            }
+        }
+
+        fn send(self: *Link, comptime T: type, message: T) !void {
+            switch (self.*) {
+                inline else => |*client| try client.send(T, message),
+            }
+        }
+
+        fn deinit(self: *Link) void {
+            switch (self.*) {
+                inline else => |*client| client.deinit(),
+            }
+        }
+    };
+
+    allocator: std.mem.Allocator,
+    link: Link,
+    messages: MessageQueue,
+    fileWriter: *FileWriter,
+    clockSync: ClockSync,
+    latencies: StreamLatencies,
+    status: std.atomic.Value(NetStatus),
+    thread: ?std.Thread,
+
+    /// Connects to the controller. self has to stay at the same address because it is the handler of the decoder.
+    pub fn init(self: *Self, allocator: std.mem.Allocator, endpoint: Endpoint, fileWriter: *FileWriter) !void {
+        self.allocator = allocator;
+        self.messages = MessageQueue.init();
+        self.fileWriter = fileWriter;
+        self.clockSync = ClockSync.init();
+        self.latencies = StreamLatencies.init();
+        self.status = std.atomic.Value(NetStatus).init(.running);
+        self.thread = null;
+        self.link = switch (endpoint) {
+            .tcp => |tcp| .{ .tcp = try NetClientT.init(allocator, tcp.hostname, tcp.port, self) },
+            .serial => |serial| .{ .serial = try SerialClientT.init(allocator, serial.path, serial.baudRate, self) },
+        };
+    }
+
+    pub fn start(self: *Self) !void {
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+    fn run(self: *Self) void {
+        while (self.getStatus() == .running) {
+            self.step() catch |err| {
+                if (err != error.ConnectionClosed) {
+                    std.log.err("Network thread stopped with error: {s}\n", .{@errorName(err)});
+                }
+                self.status.store(if (err == error.ConnectionClosed) .connectionClosed else .failed, .release);
+                return;
+            };
+        }
+    }
+
+    pub fn linkName(self: *const Self) [:0]const u8 {
+        return @tagName(self.link);
+    }
+
+    /// Waits until the socket is readable, with a timeout so stopping the thread is noticed.
+    fn step(self: *Self) !void {
+        var pfdArray = [1]posix.pollfd{.{
+            .fd = self.link.fd(),
+            .events = posix.POLL.IN,
+            .revents = 0,
+        }};
+        if (try posix.poll(&pfdArray, pollTimeoutMs) == 0) {
+            return;
+        }
+        try self.link.recv();
+    }
+
+    /// Waits if the gui fell behind by a whole queue, the controller is throttled by TCP then instead of losing messages.
+    fn push(self: *Self, message: clientContract.ClientContract) void {
+        while (!self.messages.push(message)) {
+            if (self.getStatus() != .running) {
+                if (message == .log) self.allocator.free(message.log.message);
+                return;
+            }
+            std.Thread.sleep(std.time.ns_per_ms);
+        }
+    }
+
+    fn recordLatency(self: *Self, stream: latency.Stream, deviceMicros: i64) void {
+        if (self.clockSync.ageMicros(deviceMicros)) |ageMicros| {
+            self.latencies.record(stream, ageMicros);
+        }
+    }
+
+    pub fn handleMeasurement(self: *Self, measurement: clientContract.Measurement) !void {
+        self.recordLatency(.measurement, measurement.deviceMicros);
+        self.fileWriter.push(.{ .measurement = measurement });
+        self.push(.{ .measurement = measurement });
+    }
+
+    pub fn handleTrackPoint(self: *Self, trackPoint: clientContract.TrackPoint) !void {
+        self.fileWriter.push(.{ .trackPoint = trackPoint });
+        self.push(.{ .trackPoint = trackPoint });
+    }
+
+    pub fn handleHeadingSample(self: *Self, headingSample: clientContract.HeadingSample) !void {
+        self.recordLatency(.headingSample, headingSample.deviceMicros);
+        self.push(.{ .headingSample = headingSample });
+    }
+
+    pub fn handleAccelerationSample(self: *Self, accelerationSample: clientContract.AccelerationSample) !void {
+        self.recordLatency(.accelerationSample, accelerationSample.deviceMicros);
+        self.push(.{ .accelerationSample = accelerationSample });
+    }
+
+    pub fn handleCarTrackPoint(self: *Self, carTrackPoint: clientContract.CarTrackPoint) !void {
+        self.recordLatency(.carTrackPoint, carTrackPoint.deviceMicros);
+        self.push(.{ .carTrackPoint = carTrackPoint });
+    }
+
+    /// The message is freed by the gui after it was written to the console.
+    pub fn handleLog(self: *Self, log: clientContract.Log) !void {
+        self.push(.{ .log = log });
+    }
+
+    pub fn handleConfigSnapshot(self: *Self, config: clientContract.ConfigSnapshot) !void {
+        self.push(.{ .configSnapshot = config });
+    }
+
+    pub fn handleCommand(self: *Self, command: clientContract.command) !void {
+        self.push(.{ .command = command });
+    }
+
+    pub fn handlePong(self: *Self, pong: clientContract.Pong) !void {
+        self.clockSync.addPong(pong, ClockSync.nowMicros());
+    }
+
+    /// Called by the gui thread.
+    pub fn send(self: *Self, comptime T: type, message: T) !void {
+        try self.link.send(T, message);
+    }
+
+    pub fn getStatus(self: *Self) NetStatus {
+        return self.status.load(.acquire);
+    }
+
+    pub fn deinit(self: *Self) void {
+        if (self.getStatus() == .running) {
+            self.status.store(.stopped, .release);
+        }
+        if (self.thread) |thread| {
+            thread.join();
+            self.thread = null;
+        }
+        while (self.messages.pop()) |message| {
+            if (message == .log) self.allocator.free(message.log.message);
+        }
+        self.link.deinit();
+    }
+};
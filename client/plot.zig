@@ -36,6 +36,14 @@ pub const Plot = struct {
 
     dataSets: []DataSet,
 
+    // The axes, the labels and the names of the data sets are rendered into this texture, for a plot that doesn't move
+    // also its data. It is rendered again only after a resize or if the coordinates or the data changed,
+    // every frame it is just copied to the window.
+    // A moving plot scrolls along x with every new sample, so its data and its x labels are still drawn every frame,
+    // its layer is only rendered again when the y range changes.
+    layer: ?rl.RenderTexture2D,
+    layerDirty: bool,
+
     const Self = @This();
 
     const lineThickness: f32 = 3.0;
@@ -73,18 +81,36 @@ pub const Plot = struct {
             .scaling = rl.Vector2.zero(),
 
             .dataSets = dataSets,
+
+            .layer = null,
+            .layerDirty = true,
         };
         self.resize(windowWidth, windowHeight);
         return self;
     }
 
+    /// Cheap if the size of the window didn't change, so it can be called every frame.
     pub fn resize(self: *Self, windowWidth: f32, windowHeight: f32) void {
-        self.topLeft = rl.Vector2.init(windowWidth, windowHeight).multiply(self.relativeTopLeft).addValue(self.margin);
+        const topLeft = rl.Vector2.init(windowWidth, windowHeight).multiply(self.relativeTopLeft).addValue(self.margin);
+        const size = rl.Vector2.init(windowWidth, windowHeight).multiply(self.relativeSize).addValue(-2 * self.margin);
+        if (std.meta.eql(topLeft, self.topLeft) and std.meta.eql(size, self.size)) {
+            return;
+        }
+        self.topLeft = topLeft;
         self.topLeftPlot = rl.Vector2.init(self.topLeft.x + marginCoords.x, self.topLeft.y + marginTitle);
 
-        self.size = rl.Vector2.init(windowWidth, windowHeight).multiply(self.relativeSize).addValue(-2 * self.margin);
+        self.size = size;
         self.sizePlot = rl.Vector2.init(self.size.x - marginCoords.x, self.size.y - marginTitle - marginCoords.y - marginNameXAxis);
 
+        self.rescale();
+    }
+
+    fn rescale(self: *Self) void {
+        self.updateScaling();
+        self.layerDirty = true;
+    }
+
+    fn updateScaling(self: *Self) void {
         self.scaling = .{ .x = self.sizePlot.x / (self.maxCoord.x - self.minCoord.x), .y = self.sizePlot.y / (self.maxCoord.y - self.minCoord.y) };
     }
 
@@ -101,20 +127,69 @@ pub const Plot = struct {
         };
     }
 
-    pub fn draw(self: Self) !void {
+    pub fn draw(self: *Self) !void {
+        if (self.layerDirty) {
+            try self.renderLayer();
+            self.layerDirty = false;
+        }
+        const texture = self.layer.?.texture;
+        const width: f32 = @floatFromInt(texture.width);
+        const height: f32 = @floatFromInt(texture.height);
+        // Render textures are stored upside down.
+        rl.drawTextureRec(texture, .{ .x = 0.0, .y = 0.0, .width = width, .height = -height }, self.layerTopLeft(), rl.Color.white);
+
+        if (self.moving) {
+            self.drawCoordsX();
+            for (self.dataSets) |dataSet| {
+                self.drawDataSet(dataSet);
+            }
+        }
+    }
+
+    /// The layer covers the plot and its margin, so labels reaching over the edge of the plot aren't cut off.
+    fn layerTopLeft(self: Self) rl.Vector2 {
+        return self.topLeft.addValue(-self.margin);
+    }
+
+    fn renderLayer(self: *Self) !void {
+        const width: i32 = @intFromFloat(self.size.x + 2 * self.margin);
+        const height: i32 = @intFromFloat(self.size.y + 2 * self.margin);
+        if (self.layer) |layer| {
+            if (layer.texture.width != width or layer.texture.height != height) {
+                rl.unloadRenderTexture(layer);
+                self.layer = null;
+            }
+        }
+        if (self.layer == null) {
+            self.layer = try rl.loadRenderTexture(width, height);
+        }
+
+        rl.beginTextureMode(self.layer.?);
+        defer rl.endTextureMode();
+        rl.clearBackground(rl.Color.white);
+        // Everything is drawn in window coordinates, the camera moves the top left of the layer to the top left of the texture.
+        rl.beginMode2D(.{ .offset = rl.Vector2.zero(), .target = self.layerTopLeft(), .rotation = 0.0, .zoom = 1.0 });
+        defer rl.endMode2D();
+
+        self.drawAxes();
+        for (0..self.dataSets.len, self.dataSets) |i, dataSet| {
+            if (!self.moving) {
+                self.drawDataSet(dataSet);
+            }
+            const iF: f32 = @floatFromInt(i);
+
+            rl.drawText(dataSet.name, @intFromFloat(self.topLeftPlot.x + 10.0), @intFromFloat(self.topLeftPlot.y + iF * 15.0), fontSizeNameAxis, dataSet.color);
+        }
+    }
+
+    fn drawAxes(self: Self) void {
         const coordSysOrigin = rl.Vector2.init(self.topLeftPlot.x, self.topLeftPlot.y + self.sizePlot.y);
         const horizontalLineSize = rl.Vector2.init(self.sizePlot.x + lineThickness, lineThickness);
 
         rl.drawRectangleV(coordSysOrigin, horizontalLineSize, self.color);
 
-        const countCoordinatesToShowX: usize = @intFromFloat(horizontalLineSize.x / marginBetweenCoords);
-        const countCoordinatesToShowXF: f32 = @floatFromInt(countCoordinatesToShowX);
-        for (0..countCoordinatesToShowX + 1) |i| {
-            const iF: f32 = @floatFromInt(i);
-            const coordTextPosX: f32 = coordSysOrigin.x + horizontalLineSize.x * iF / countCoordinatesToShowXF;
-            const buffer = std.fmt.bufPrintZ(&array, "{d:.1}", .{self.minCoord.x + (self.maxCoord.x - self.minCoord.x) * iF / countCoordinatesToShowXF}) catch unreachable;
-            const coordWidth: f32 = @floatFromInt(rl.measureText(buffer, fontSizeCoords));
-            rl.drawText(buffer, @intFromFloat(coordTextPosX - coordWidth / 2.0), @intFromFloat(coordSysOrigin.y + lineThickness + marginLineCoords), fontSizeCoords, self.color);
+        if (!self.moving) {
+            self.drawCoordsX();
         }
         const nameXAxisWidth: f32 = @floatFromInt(rl.measureText(self.nameXAxis, fontSizeNameAxis));
         rl.drawText(self.nameXAxis, @intFromFloat(self.topLeftPlot.x + self.sizePlot.x / 2.0 - nameXAxisWidth / 2.0), @intFromFloat(self.topLeft.y + self.size.y - marginNameXAxis), fontSizeNameAxis, self.color);
@@ -137,12 +212,19 @@ pub const Plot = struct {
         const titlePosY: i32 = @intFromFloat(self.topLeft.y);
         const titleWidth = rl.measureText(self.name, fontSizeTitle);
         rl.drawText(self.name, titlePosX - @divTrunc(titleWidth, 2), titlePosY, fontSizeTitle, self.color);
+    }
 
-        for (0..self.dataSets.len, self.dataSets) |i, dataSet| {
-            self.drawDataSet(dataSet);
+    fn drawCoordsX(self: Self) void {
+        const coordSysOrigin = rl.Vector2.init(self.topLeftPlot.x, self.topLeftPlot.y + self.sizePlot.y);
+        const horizontalLineSizeX = self.sizePlot.x + lineThickness;
+        const countCoordinatesToShowX: usize = @intFromFloat(horizontalLineSizeX / marginBetweenCoords);
+        const countCoordinatesToShowXF: f32 = @floatFromInt(countCoordinatesToShowX);
+        for (0..countCoordinatesToShowX + 1) |i| {
             const iF: f32 = @floatFromInt(i);
-
-            rl.drawText(dataSet.name, @intFromFloat(self.topLeftPlot.x + 10.0), @intFromFloat(self.topLeftPlot.y + iF * 15.0), fontSizeNameAxis, dataSet.color);
+            const coordTextPosX: f32 = coordSysOrigin.x + horizontalLineSizeX * iF / countCoordinatesToShowXF;
+            const buffer = std.fmt.bufPrintZ(&array, "{d:.1}", .{self.minCoord.x + (self.maxCoord.x - self.minCoord.x) * iF / countCoordinatesToShowXF}) catch unreachable;
+            const coordWidth: f32 = @floatFromInt(rl.measureText(buffer, fontSizeCoords));
+            rl.drawText(buffer, @intFromFloat(coordTextPosX - coordWidth / 2.0), @intFromFloat(coordSysOrigin.y + lineThickness + marginLineCoords), fontSizeCoords, self.color);
         }
     }
 
@@ -178,12 +260,26 @@ pub const Plot = struct {
         for (0..self.dataSets.len) |i| {
             if (std.mem.eql(u8, dataSetName, self.dataSets[i].name)) {
                 self.dataSets[i].points.clearAndFree(self.allocator);
+                self.layerDirty = true;
                 return;
             }
         }
     }
 
     pub fn addPoints(self: *Self, dataSetName: []const u8, points: []const rl.Vector2) !void {
+        const prevMinCoord = self.minCoord;
+        const prevMaxCoord = self.maxCoord;
+        // Scrolling a moving plot along x doesn't change anything in its layer, the x labels are drawn every frame.
+        defer {
+            const changedX = prevMinCoord.x != self.minCoord.x or prevMaxCoord.x != self.maxCoord.x;
+            const changedY = prevMinCoord.y != self.minCoord.y or prevMaxCoord.y != self.maxCoord.y;
+            if (changedY or (changedX and !self.moving)) {
+                self.rescale();
+            } else if (changedX) {
+                self.updateScaling();
+            }
+        }
+
         if (self.moving) {
             if (points[points.len - 1].x > self.maxCoord.x) {
                 self.minCoord.x += points[points.len - 1].x - self.maxCoord.x;
@@ -221,6 +317,9 @@ pub const Plot = struct {
         for (0..self.dataSets.len) |i| {
             if (std.mem.eql(u8, dataSetName, self.dataSets[i].name)) {
                 try self.dataSets[i].points.appendSlice(self.allocator, points);
+                if (!self.moving) {
+                    self.layerDirty = true;
+                }
                 return;
             }
         }
@@ -228,6 +327,9 @@ pub const Plot = struct {
     }
 
     pub fn deinit(self: *Self) void {
+        if (self.layer) |layer| {
+            rl.unloadRenderTexture(layer);
+        }
         for (self.dataSets) |*dataSet| {
             dataSet.points.deinit(self.allocator);
         }
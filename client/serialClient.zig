@@ -0,0 +1,106 @@
+const std = @import("std");
+const posix = std.posix;
+
+const decode = @import("decode");
+const encode = @import("encode");
+
+const termios = @cImport(@cInclude("termios.h"));
+
+/// The same contracts and message format as NetClient over a serial port, for the serial transport of the controller.
+/// The port can be opened in the middle of a message of the controller, so malformed messages are skipped
+/// instead of failing.
+/// receiveBufferSize is the most that is read from the port at once, recv reads until the port would block.
+pub fn SerialClient(comptime clientContractEnumT: type, comptime clientContractT: type, comptime handlerT: type, comptime serverContract: type, comptime receiveBufferSize: usize) type {
+    return struct {
+        allocator: std.mem.Allocator,
+        // Named like the socket of NetClient, the network thread polls it.
+        socket: posix.fd_t,
+        decoder: decode.Decoder(clientContractEnumT, clientContractT, handlerT),
+
+        const Encoder = encode.Encoder(serverContract);
+
+        const Self = @This();
+        const sendTimeoutMs = 1000;
+        var buffer: [receiveBufferSize]u8 = undefined;
+
+        pub fn init(allocator: std.mem.Allocator, path: []const u8, baudRate: u32, handler: *handlerT) !Self {
+            const socket = try posix.open(path, .{ .ACCMODE = .RDWR, .NOCTTY = true, .NONBLOCK = true }, 0);
+            errdefer posix.close(socket);
+
+            var tty: termios.struct_termios = undefined;
+            if (termios.tcgetattr(socket, &tty) != 0) {
+                return error.SerialConfigFailed;
+            }
+            termios.cfmakeraw(&tty);
+            tty.c_cflag |= termios.CLOCAL | termios.CREAD;
+            if (termios.cfsetspeed(&tty, try speed(baudRate)) != 0) {
+                return error.UnsupportedBaudRate;
+            }
+            if (termios.tcsetattr(socket, termios.TCSANOW, &tty) != 0) {
+                return error.SerialConfigFailed;
+            }
+            // Whatever the controller sent before isn't waited for, decoding starts with its next message.
+            _ = termios.tcflush(socket, termios.TCIOFLUSH);
+
+            const decoder = decode.Decoder(clientContractEnumT, clientContractT, handlerT).init(allocator, handler);
+            return .{ .allocator = allocator, .socket = socket, .decoder = decoder };
+        }
+
+        fn speed(baudRate: u32) !termios.speed_t {
+            return switch (baudRate) {
+                115200 => termios.B115200,
+                230400 => termios.B230400,
+                460800 => termios.B460800,
+                921600 => termios.B921600,
+                1000000 => termios.B1000000,
+                1500000 => termios.B1500000,
+                2000000 => termios.B2000000,
+                3000000 => termios.B3000000,
+                else => error.UnsupportedBaudRate,
+            };
+        }
+
+        /// Reads and decodes until there is nothing left on the port, so telemetry doesn't lag behind by more than a frame.
+        pub fn recv(self: *Self) !void {
+            while (true) {
+                const bytesRead = posix.read(self.socket, &buffer) catch |err| switch (err) {
+                    error.WouldBlock => return,
+                    else => return err,
+                };
+                if (bytesRead == 0) {
+                    return error.ConnectionClosed;
+                }
+                const errorCount = try self.decoder.decodeSkippingErrors(buffer[0..bytesRead]);
+                if (errorCount > 0) {
+                    std.log.warn("Skipped {d} malformed messages.\n", .{errorCount});
+                }
+            }
+        }
+
+        /// Waits until the port is writable while its output buffer is full, instead of spinning on the gui thread.
+        pub fn send(self: Self, comptime T: type, message: T) !void {
+            const bytes = try Encoder.encode(T, message);
+            var index: usize = 0;
+            while (index < bytes.len) {
+                index += posix.write(self.socket, bytes[index..]) catch |err| switch (err) {
+                    error.WouldBlock => {
+                        var pfdArray = [1]posix.pollfd{.{
+                            .fd = self.socket,
+                            .events = posix.POLL.OUT,
+                            .revents = 0,
+                        }};
+                        if (try posix.poll(&pfdArray, sendTimeoutMs) == 0) {
+                            return error.SendTimeout;
+                        }
+                        continue;
+                    },
+                    else => return err,
+                };
+            }
+        }
+
+        pub fn deinit(self: Self) void {
+            posix.close(self.socket);
+        }
+    };
+}
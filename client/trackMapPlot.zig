@@ -19,7 +19,8 @@ pub const TrackMapPlot = struct {
         self.plot.resize(windowWidth, windowHeight);
     }
 
-    pub fn draw(self: Self) !void {
+    /// The track is part of the cached layer of the plot, only the car is drawn every frame.
+    pub fn draw(self: *Self) !void {
         try self.plot.draw();
     }
 
@@ -1,18 +1,76 @@
+#include "pcnt.h"
+
+// Only compiled on chips with a pulse counter, the ESP32-C3 has none and the tacho uses the timer there.
+#if PCNT_SUPPORTED
+
+#include "esp_attr.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "driver/pulse_cnt.h"
+#include "freertos/FreeRTOS.h"
 
+#define HIGH_LIMIT_MAX 32767
 
 pcnt_unit_handle_t pcntUnit;
 
-void pcntInit() {
+static portMUX_TYPE periodLock = portMUX_INITIALIZER_UNLOCKED;
+static int highLimit = HIGH_LIMIT_MAX;
+static volatile int64_t overflows = 0;
+static volatile int64_t eventCount = 0;
+static volatile int64_t eventTime = 0;
+static volatile int64_t prevEventCount = 0;
+static volatile int64_t prevEventTime = 0;
+static volatile bool updatedPeriod = false;
+static volatile uint32_t interruptCount = 0;
+// The watch point and the watch step both fire at the high limit, only the first of the two counts the overflow.
+static volatile bool highLimitCounted = false;
+
+// Called every watchStep pulses and when the hardware counter wraps at the high limit.
+// The time between two events gives the period of watchStep pulses without an interrupt per pulse.
+static bool IRAM_ATTR watch_isr(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *eventData, void *userContext) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&periodLock);
+    interruptCount++;
+    if (eventData->watch_point_value == highLimit) {
+        if (highLimitCounted) {
+            portEXIT_CRITICAL_ISR(&periodLock);
+            return false;
+        }
+        highLimitCounted = true;
+        overflows++;
+    } else {
+        highLimitCounted = false;
+    }
+    int64_t count = overflows * highLimit + (eventData->watch_point_value == highLimit ? 0 : eventData->watch_point_value);
+    if (count != eventCount) {
+        prevEventCount = eventCount;
+        prevEventTime = eventTime;
+        eventCount = count;
+        eventTime = now;
+        updatedPeriod = prevEventTime != 0;
+    }
+    portEXIT_CRITICAL_ISR(&periodLock);
+    return false;
+}
+
+void pcntInit(int gpio, int watchStep) {
+    // At most half the high limit, so there is always a step event between two overflows
+    // and two events at the high limit without one in between are the same edge.
+    if (watchStep > PCNT_MAX_WATCH_STEP) {
+        watchStep = PCNT_MAX_WATCH_STEP;
+    }
+    // The high limit has to be a multiple of the watch step, so wrapping doesn't shift the events.
+    highLimit = HIGH_LIMIT_MAX - HIGH_LIMIT_MAX % watchStep;
+
     pcnt_unit_config_t unitConfig = {
-        .high_limit = 32767,
+        .high_limit = highLimit,
         .low_limit = -1,
+        .flags.accum_count = true,
     };
     ESP_ERROR_CHECK(pcnt_new_unit(&unitConfig, &pcntUnit));
 
     pcnt_chan_config_t channelConfig = {
-        .edge_gpio_num = 9,
+        .edge_gpio_num = gpio,
         .level_gpio_num = -1,
     };
 
@@ -25,6 +83,15 @@ void pcntInit() {
         PCNT_CHANNEL_EDGE_ACTION_HOLD
     ));
 
+    // Needed for accumulating the count when the hardware counter overflows.
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(pcntUnit, highLimit));
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_step(pcntUnit, watchStep));
+
+    pcnt_event_callbacks_t callbacks = {
+        .on_reach = watch_isr,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_register_event_callbacks(pcntUnit, &callbacks, NULL));
+
     ESP_ERROR_CHECK(pcnt_unit_enable(pcntUnit));
 }
 
@@ -34,10 +101,44 @@ int pcntGetCount() {
     return pulseCount;
 }
 
+bool pcntGetPeriod(PcntPeriod *period) {
+    portENTER_CRITICAL(&periodLock);
+    bool updated = updatedPeriod;
+    if (updated) {
+        period->pulses = (int)(eventCount - prevEventCount);
+        period->seconds = (float)(eventTime - prevEventTime) / 1e6;
+        updatedPeriod = false;
+    }
+    portEXIT_CRITICAL(&periodLock);
+    return updated;
+}
+
+int64_t pcntMicrosSinceLastEvent() {
+    portENTER_CRITICAL(&periodLock);
+    int64_t lastEventTime = eventTime;
+    portEXIT_CRITICAL(&periodLock);
+    return esp_timer_get_time() - lastEventTime;
+}
+
+uint32_t pcntGetInterruptCount() {
+    return interruptCount;
+}
+
 void pcntReset() {
     ESP_ERROR_CHECK(pcnt_unit_clear_count(pcntUnit));
+    portENTER_CRITICAL(&periodLock);
+    overflows = 0;
+    eventCount = 0;
+    eventTime = 0;
+    prevEventCount = 0;
+    prevEventTime = 0;
+    updatedPeriod = false;
+    highLimitCounted = false;
+    portEXIT_CRITICAL(&periodLock);
 }
 
 void pcntStart() {
     ESP_ERROR_CHECK(pcnt_unit_start(pcntUnit));
 }
+
+#endif
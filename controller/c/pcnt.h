@@ -1,8 +1,31 @@
 #ifndef __PCNT__
 #define __PCNT__
 
-void pcntInit();
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soc/soc_caps.h"
+
+// The functions below only exist if it is 1.
+#if SOC_PCNT_SUPPORTED && SOC_PCNT_SUPPORT_STEP_NOTIFY
+#define PCNT_SUPPORTED 1
+#else
+#define PCNT_SUPPORTED 0
+#endif
+
+typedef struct {
+    int pulses;
+    float seconds;
+} PcntPeriod;
+
+// Larger watch steps are clamped to it in pcntInit.
+#define PCNT_MAX_WATCH_STEP 16383
+
+void pcntInit(int gpio, int watchStep);
 int pcntGetCount();
+bool pcntGetPeriod(PcntPeriod *period);
+int64_t pcntMicrosSinceLastEvent();
+uint32_t pcntGetInterruptCount();
 void pcntReset();
 void pcntStart();
 
@@ -9,12 +9,14 @@
 
 static volatile uint64_t startPeriod = 0;
 static volatile uint64_t endPeriod = 0;
+static volatile uint32_t interruptCount = 0;
 gptimer_handle_t timerHandle;
 #include <inttypes.h>
 
 
 
 static void IRAM_ATTR pulse_isr(void *arg) {
+    interruptCount++;
     startPeriod = endPeriod;
     gptimer_get_raw_count(timerHandle, &endPeriod);
     //esp_rom_printf("interrupt, count=%" PRIu64 "\n", endPeriod);
@@ -58,3 +60,7 @@ bool ptUpdatedPeriod() {
 void ptResetPeriod() {
     startPeriod = endPeriod;
 }
+
+uint32_t ptGetInterruptCount() {
+    return interruptCount;
+}
@@ -2,10 +2,12 @@
 #define __PT__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 void ptInit();
 float ptGetPeriod();
 void ptResetPeriod();
 bool ptUpdatedPeriod();
+uint32_t ptGetInterruptCount();
 
 #endif
@@ -1,11 +1,16 @@
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "esp_log.h"
+
 #include "rtos.h"
 #include "portmacro.h"
 
+static const char *TAG = "rtos";
+
 
 void rtosTaskYield() {
     taskYIELD();
@@ -25,6 +30,27 @@ void rtosXTaskCreate(void (*function)(void *), char *const name, const uint32_t
     xTaskCreate(function, name, stackSize, arguments, priority, NULL);
 }
 
+// core < 0 lets the scheduler run the task on any core.
+void rtosXTaskCreatePinnedToCore(void (*function)(void *), char *const name, const uint32_t stackSize, void *arguments, unsigned int priority, int core) {
+    BaseType_t coreId = core < 0 ? tskNO_AFFINITY : core;
+    if (xTaskCreatePinnedToCore(function, name, stackSize, arguments, priority, NULL, coreId) != pdPASS) {
+        ESP_LOGE(TAG, "Creating task %s failed.", name);
+        abort();
+    }
+}
+
+void rtosVTaskDeleteSelf() {
+    vTaskDelete(NULL);
+}
+
+int rtosCoreCount() {
+    return portNUM_PROCESSORS;
+}
+
+unsigned int rtosMaxPriority() {
+    return configMAX_PRIORITIES - 1;
+}
+
 void rtosVTaskDelay(uint32_t xTicksToDelay) {
     vTaskDelay(xTicksToDelay);
 }
@@ -32,3 +58,7 @@ void rtosVTaskDelay(uint32_t xTicksToDelay) {
 uint32_t rtosMillisToTicks(uint32_t millis) {
     return millis / portTICK_PERIOD_MS;
 }
+
+uint32_t rtosTickPeriodMillis() {
+    return portTICK_PERIOD_MS;
+}
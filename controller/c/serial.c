@@ -0,0 +1,86 @@
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "serial.h"
+
+// The console and the logs stay on UART0, the contracts go over UART1 to a USB serial adapter.
+#define SERIAL_UART UART_NUM_1
+#define SERIAL_TX_GPIO 4
+#define SERIAL_RX_GPIO 5
+// The driver moves the bytes between the hardware FIFOs and these ring buffers in its interrupt,
+// so reading and writing only copy and never wait on the line unless the transmit buffer is full.
+#define SERIAL_RX_BUFFER_SIZE 4096
+#define SERIAL_TX_BUFFER_SIZE 4096
+#define SERIAL_EVENT_QUEUE_SIZE 16
+// In symbols, received bytes are reported after the line was idle this long even if the FIFO threshold isn't reached.
+#define SERIAL_RX_TIMEOUT 4
+
+static const char *TAG = "serial";
+
+static QueueHandle_t eventQueue;
+
+void serialInit(int baudRate) {
+    uart_config_t config = {
+        .baud_rate = baudRate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    ESP_ERROR_CHECK(uart_driver_install(SERIAL_UART, SERIAL_RX_BUFFER_SIZE, SERIAL_TX_BUFFER_SIZE, SERIAL_EVENT_QUEUE_SIZE, &eventQueue, 0));
+    ESP_ERROR_CHECK(uart_param_config(SERIAL_UART, &config));
+    ESP_ERROR_CHECK(uart_set_pin(SERIAL_UART, SERIAL_TX_GPIO, SERIAL_RX_GPIO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_rx_timeout(SERIAL_UART, SERIAL_RX_TIMEOUT));
+    // Whatever arrived before, for example while the adapter was plugged in, isn't part of a message.
+    ESP_ERROR_CHECK(uart_flush_input(SERIAL_UART));
+    ESP_LOGI(TAG, "Serial link on UART%d with %d baud, tx gpio %d, rx gpio %d", SERIAL_UART, baudRate, SERIAL_TX_GPIO, SERIAL_RX_GPIO);
+}
+
+// Returns SERIAL_DATA when bytes were received within ticks. After an overflow the received bytes are dropped
+// and SERIAL_OVERFLOW is returned, the caller has to drop the message it started decoding.
+int serialWaitForData(uint32_t ticks) {
+    uart_event_t event;
+    if (xQueueReceive(eventQueue, &event, ticks) != pdTRUE) {
+        return SERIAL_NO_DATA;
+    }
+    if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+        ESP_LOGW(TAG, "Receive buffer overflowed, dropping the received bytes.");
+        uart_flush_input(SERIAL_UART);
+        xQueueReset(eventQueue);
+        return SERIAL_OVERFLOW;
+    }
+    return event.type == UART_DATA ? SERIAL_DATA : SERIAL_NO_DATA;
+}
+
+// Never blocks, returns the number of bytes read or SERIAL_FAILED.
+int serialRead(uint8_t *buffer, size_t size) {
+    size_t buffered = 0;
+    if (uart_get_buffered_data_len(SERIAL_UART, &buffered) != ESP_OK) {
+        return SERIAL_FAILED;
+    }
+    if (buffered == 0) {
+        return 0;
+    }
+    int bytesRead = uart_read_bytes(SERIAL_UART, buffer, buffered < size ? buffered : size, 0);
+    if (bytesRead < 0) {
+        ESP_LOGE(TAG, "Reading failed.");
+        return SERIAL_FAILED;
+    }
+    return bytesRead;
+}
+
+// Blocks until all bytes are in the transmit buffer.
+int serialWrite(const uint8_t *buffer, size_t size) {
+    if (uart_write_bytes(SERIAL_UART, buffer, size) != (int)size) {
+        ESP_LOGE(TAG, "Writing failed.");
+        return SERIAL_FAILED;
+    }
+    return SERIAL_OK;
+}
+
+void serialDeinit() {
+    uart_driver_delete(SERIAL_UART);
+}
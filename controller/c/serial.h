@@ -0,0 +1,21 @@
+#ifndef __SERIAL__
+#define __SERIAL__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERIAL_OK 0
+#define SERIAL_FAILED -1
+
+// Results of serialWaitForData.
+#define SERIAL_NO_DATA 0
+#define SERIAL_DATA 1
+#define SERIAL_OVERFLOW 2
+
+void serialInit(int baudRate);
+int serialWaitForData(uint32_t ticks);
+int serialRead(uint8_t *buffer, size_t size);
+int serialWrite(const uint8_t *buffer, size_t size);
+void serialDeinit();
+
+#endif
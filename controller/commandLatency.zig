@@ -0,0 +1,52 @@
+const std = @import("std");
+
+const utilsZig = @import("utils.zig");
+const utils = @cImport(@cInclude("utils.h"));
+
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const tag = "command latency";
+
+/// Measures the time from receiving a setSpeed command in the net task until the control step which applied it ended.
+/// The statistics are logged and reset every reportInterval applied commands.
+pub const CommandLatency = struct {
+    const Self = @This();
+    const reportInterval: u32 = 100;
+
+    count: u32,
+    sumMicros: u64,
+    maxMicros: u32,
+    coalesced: u32,
+
+    pub fn init() Self {
+        return .{
+            .count = 0,
+            .sumMicros = 0,
+            .maxMicros = 0,
+            .coalesced = 0,
+        };
+    }
+
+    pub fn nowMicros() u32 {
+        return @truncate(@as(u64, @bitCast(utilsZig.timestampMicros())));
+    }
+
+    pub fn applied(self: *Self, receivedMicros: u32, coalesced: u32) void {
+        const latencyMicros = nowMicros() -% receivedMicros;
+        self.sumMicros += latencyMicros;
+        self.maxMicros = @max(self.maxMicros, latencyMicros);
+        self.coalesced += coalesced;
+        self.count += 1;
+
+        if (self.count < reportInterval) {
+            return;
+        }
+        const avgMicros: c_int = @intCast(self.sumMicros / self.count);
+        const maxMicros: c_int = @intCast(self.maxMicros);
+        const coalescedCount: c_int = @intCast(self.coalesced);
+        utils.espLog(esp.ESP_LOG_INFO, tag, "setSpeed to actuation avg %d us, max %d us, %d stale commands coalesced", avgMicros, maxMicros, coalescedCount);
+        self.* = init();
+    }
+};
@@ -0,0 +1,113 @@
+const std = @import("std");
+
+const encode = @import("encode");
+const decode = @import("decode");
+const Config = @import("config").Config;
+
+const utils = @cImport(@cInclude("utils.h"));
+const rtos = @cImport(@cInclude("rtos.h"));
+
+const esp = @cImport({
+    @cInclude("nvs.h");
+    @cInclude("nvs_flash.h");
+    @cInclude("esp_log.h");
+});
+
+const tag = "config storage";
+const namespace = "storage";
+const configKey = "config";
+const layoutKey = "configLayout";
+
+const StorageContractEnum = enum(u8) {
+    config,
+};
+
+/// The config is stored in the same format as it is sent over the network.
+const StorageContract = union(StorageContractEnum) {
+    config: Config,
+};
+
+/// Changes when a field of the config is added, removed, renamed or changes its type,
+/// so a stored config of another firmware is not decoded into the wrong fields.
+const layoutHash: u32 = blk: {
+    @setEvalBranchQuota(100_000);
+    var hasher = std.hash.Fnv1a_32.init();
+    for (@typeInfo(Config).@"struct".fields) |field| {
+        hasher.update(field.name);
+        hasher.update(@typeName(field.type));
+    }
+    break :blk hasher.final();
+};
+
+const Loader = struct {
+    config: *Config,
+
+    pub fn handleConfig(self: *Loader, config: Config) !void {
+        self.config.* = config;
+    }
+};
+
+fn open(handle: *esp.nvs_handle_t) !void {
+    const err = esp.nvs_open(namespace, esp.NVS_READWRITE, handle);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error opening flash memory handle: %s", esp.esp_err_to_name(err));
+        return error.NvsOpenFailed;
+    }
+}
+
+/// Overwrites the config with the stored one, returns false if there is none, it was stored by a firmware with another config layout
+/// or it isn't valid, then the config is left unchanged.
+pub fn load(allocator: std.mem.Allocator, config: *Config) !bool {
+    var nvsHandle: esp.nvs_handle_t = undefined;
+    try open(&nvsHandle);
+    defer esp.nvs_close(nvsHandle);
+
+    var storedLayoutHash: u32 = 0;
+    if (esp.nvs_get_u32(nvsHandle, layoutKey, &storedLayoutHash) != esp.ESP_OK or storedLayoutHash != layoutHash) {
+        return false;
+    }
+
+    var buffer: [encode.MAX_MESSAGE_LENGTH]u8 = undefined;
+    var length: usize = buffer.len;
+    const err = esp.nvs_get_blob(nvsHandle, configKey, &buffer, &length);
+    if (err != esp.ESP_OK) {
+        if (err != esp.ESP_ERR_NVS_NOT_FOUND) {
+            utils.espLog(esp.ESP_LOG_ERROR, tag, "Error reading config: %s", esp.esp_err_to_name(err));
+        }
+        return false;
+    }
+
+    var stored = config.*;
+    var loader: Loader = .{ .config = &stored };
+    var decoder = decode.Decoder(StorageContractEnum, StorageContract, Loader).init(allocator, &loader);
+    try decoder.decode(buffer[0..length]);
+    stored.validate(rtos.rtosTickPeriodMillis()) catch |validationErr| {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Ignoring the stored config, it is invalid: %s", @errorName(validationErr).ptr);
+        return false;
+    };
+    config.* = stored;
+    return true;
+}
+
+pub fn save(config: *const Config) !void {
+    var nvsHandle: esp.nvs_handle_t = undefined;
+    try open(&nvsHandle);
+    defer esp.nvs_close(nvsHandle);
+
+    const bytes = try encode.Encoder(StorageContract).encode(Config, config.*);
+    var err = esp.nvs_set_blob(nvsHandle, configKey, bytes.ptr, bytes.len);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error writing config: %s", esp.esp_err_to_name(err));
+        return error.NvsWriteFailed;
+    }
+    err = esp.nvs_set_u32(nvsHandle, layoutKey, layoutHash);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error writing config layout: %s", esp.esp_err_to_name(err));
+        return error.NvsWriteFailed;
+    }
+    err = esp.nvs_commit(nvsHandle);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error commiting config to flash memory: %s", esp.esp_err_to_name(err));
+        return error.NvsWriteFailed;
+    }
+}
@@ -3,12 +3,17 @@ const std = @import("std");
 const clientContract = @import("clientContract");
 const serverContract = @import("serverContract");
 const encode = @import("encode");
-const NetServer = @import("netServer.zig").NetServer;
+const netTaskMod = @import("netTask.zig");
+const NetTask = netTaskMod.NetTask;
+const Telemetry = netTaskMod.Telemetry;
 
 const pwm = @cImport(@cInclude("pwm.h"));
 const rtos = @cImport(@cInclude("rtos.h"));
 const utils = @cImport(@cInclude("utils.h"));
 const utilsZig = @import("utils.zig");
+const placement = @import("placement");
+const LoopTiming = @import("loopTiming.zig").LoopTiming;
+const CommandLatency = @import("commandLatency.zig").CommandLatency;
 
 const Bmi = @import("bmi.zig").Bmi;
 const Tacho = @import("tacho.zig").Tacho;
@@ -17,7 +22,8 @@ const Config = configMod.Config;
 const trackMod = @import("track");
 const Track = trackMod.Track(true);
 const TrackPoint = trackMod.TrackPoint;
-const KalmanFilter = @import("kalmanFilter.zig").KalmanFilter;
+const Localizer = @import("localizer.zig").Localizer;
+const configStorage = @import("configStorage.zig");
 
 const c = @cImport({
     @cInclude("stdio.h");
@@ -43,12 +49,12 @@ const SelfDrive = @import("controllerStates/selfDrive.zig").SelfDrive;
 const UserDrive = @import("controllerStates/userDrive.zig").UserDrive;
 const Stop = @import("controllerStates/stop.zig").Stop;
 const OptimalSelfDrive = @import("controllerStates/optimalSelfDrive.zig").OptimalSelfDrive;
+const AdaptiveSelfDrive = @import("controllerStates/adaptiveSelfDrive.zig").AdaptiveSelfDrive;
 
 const tag = "controller";
 
 pub const Controller = struct {
     const Self = @This();
-    const NetServerT = NetServer(serverContract.ServerContractEnum, serverContract.ServerContract, Controller, clientContract.ClientContract);
 
     allocator: std.mem.Allocator,
     arena: std.heap.ArenaAllocator,
@@ -56,7 +62,8 @@ pub const Controller = struct {
     config: *Config,
     bmi: Bmi,
     tacho: Tacho,
-    netServer: NetServerT,
+    netTask: *NetTask,
+    telemetry: Telemetry,
 
     state: *ControllerState,
 
@@ -65,12 +72,15 @@ pub const Controller = struct {
     mapTrack: MapTrack,
     stop: Stop,
     optimalSelfDrive: OptimalSelfDrive,
+    adaptiveSelfDrive: AdaptiveSelfDrive,
 
     initTime: i64,
+    loopTiming: LoopTiming,
+    commandLatency: CommandLatency,
     track: ?Track,
-    kalmanFilter: ?KalmanFilter,
+    localizer: ?Localizer,
 
-    pub fn init(allocator: std.mem.Allocator, config: *Config, bmi: Bmi, tacho: Tacho, netServer: NetServerT) !Self {
+    pub fn init(allocator: std.mem.Allocator, config: *Config, bmi: Bmi, tacho: Tacho, netTask: *NetTask) !Self {
         return .{
             .allocator = allocator,
             .arena = std.heap.ArenaAllocator.init(allocator),
@@ -78,7 +88,8 @@ pub const Controller = struct {
             .config = config,
             .bmi = bmi,
             .tacho = tacho,
-            .netServer = netServer,
+            .netTask = netTask,
+            .telemetry = Telemetry.init(allocator, &netTask.telemetry, &netTask.subscriptions),
 
             .state = undefined,
 
@@ -87,10 +98,13 @@ pub const Controller = struct {
             .mapTrack = MapTrack.init(),
             .stop = Stop.init(),
             .optimalSelfDrive = OptimalSelfDrive.init(),
+            .adaptiveSelfDrive = AdaptiveSelfDrive.init(),
 
             .initTime = @divTrunc(utilsZig.timestampMicros(), 1000),
+            .loopTiming = LoopTiming.init(),
+            .commandLatency = CommandLatency.init(),
             .track = null,
-            .kalmanFilter = null,
+            .localizer = null,
         };
     }
 
@@ -101,36 +115,76 @@ pub const Controller = struct {
     pub fn run(self: *Self) !void {
         var lastWake = rtos.rtosXTaskGetTickCount();
         while (true) {
-            self.netServer.recv() catch |err| switch (err) {
-                error.ConnectionClosed => return,
-                else => return err,
-            };
+            switch (self.netTask.getStatus()) {
+                .running => {},
+                .connectionClosed => return,
+                .failed => return error.NetworkFailed,
+            }
 
+            self.loopTiming.startStep();
+            while (self.netTask.commands.pop()) |command| {
+                try self.handleCommand(command);
+            }
+            const speed = self.netTask.latestSpeed.take();
+            if (speed) |s| {
+                try self.handleCommand(.{ .setSpeed = .{ .speed = s.value } });
+            }
             try self.step();
+            if (speed) |s| {
+                self.commandLatency.applied(s.receivedMicros, s.coalesced);
+            }
+            self.loopTiming.endStep();
             _ = self.arena.reset(.{ .retain_with_limit = 1000});
             rtos.rtosVTaskDelayUntil(&lastWake, rtos.rtosMillisToTicks(self.config.deltaTimeMs));
         }
     }
 
-    fn step(self: *Self) !void {
+    fn step(self: *Self) linksection(placement.hotText("controller.step")) !void {
         try self.bmi.update();
         try self.tacho.update();
-        if (self.kalmanFilter) |*kalmanFilter| {
-            kalmanFilter.update();
+        if (self.localizer) |*localizer| {
+            localizer.update();
         }
         try self.state.step(self);
 
-        const time: f32 = @floatFromInt(@divTrunc(utilsZig.timestampMicros(), 1000) - self.initTime);
-        const measurement: clientContract.Measurement = .{
-            .time = time / 1_000.0,
-            .heading = self.bmi.heading,
-            .accelerationX = self.bmi.prevAccel.x,
-            .accelerationY = self.bmi.prevAccel.y,
-            .accelerationZ = self.bmi.prevAccel.z,
-            .velocity = self.tacho.velocity,
-            .distance = self.tacho.distance,
-        };
-        try self.netServer.send(clientContract.Measurement, measurement);
+        try self.sendTelemetry();
+    }
+
+    /// Sends the streams which are due in this tick, the others aren't built at all.
+    fn sendTelemetry(self: *Self) linksection(placement.hotText("controller.sendTelemetry")) !void {
+        const deltaTimeMs = self.config.deltaTimeMs;
+        const measurementDue = self.telemetry.due(.measurement, deltaTimeMs);
+        const headingDue = self.telemetry.due(.heading, deltaTimeMs);
+        const accelerationDue = self.telemetry.due(.acceleration, deltaTimeMs);
+        if (!measurementDue and !headingDue and !accelerationDue) {
+            return;
+        }
+
+        const timeMs: f32 = @floatFromInt(@divTrunc(utilsZig.timestampMicros(), 1000) - self.initTime);
+        const time = timeMs / 1_000.0;
+        if (measurementDue) {
+            const measurement: clientContract.Measurement = .{
+                .time = time,
+                .heading = self.bmi.heading,
+                .accelerationX = self.bmi.prevAccel.x,
+                .accelerationY = self.bmi.prevAccel.y,
+                .accelerationZ = self.bmi.prevAccel.z,
+                .velocity = self.tacho.velocity,
+                .distance = self.tacho.distance,
+            };
+            try self.telemetry.send(clientContract.Measurement, measurement);
+        }
+        if (headingDue) {
+            try self.telemetry.send(clientContract.HeadingSample, .{ .time = time, .heading = self.bmi.heading });
+        }
+        if (accelerationDue) {
+            try self.telemetry.send(clientContract.AccelerationSample, .{
+                .time = time,
+                .accelerationX = self.bmi.prevAccel.x,
+                .accelerationY = self.bmi.prevAccel.y,
+                .accelerationZ = self.bmi.prevAccel.z,
+            });
+        }
     }
 
     fn toMessage(comptime T: type, arenaAllocator: std.mem.Allocator, fieldName: []const u8, value: T) ![]u8 {
@@ -158,7 +212,7 @@ pub const Controller = struct {
                         .level = clientContract.LogLevel.info,
                         .message = try toMessage(field.type, self.arena.allocator(), field.name, @field(self.config, field.name)),
                     };
-                    try self.netServer.send(clientContract.Log, log);
+                    try self.telemetry.send(clientContract.Log, log);
                     return;
                 }
             }
@@ -168,11 +222,13 @@ pub const Controller = struct {
                 const upperFirst: [1]u8 = comptime .{ std.ascii.toUpper(field.name[0]) };
                 const setterName = "set" ++ upperFirst ++ field.name[1..];
                 if (std.mem.eql(u8, tagName, setterName)) {
-                    @field(self.config, field.name) = @field(@field(configCommands, setterName), field.name);
-                    break;
+                    var newConfig = self.config.*;
+                    @field(newConfig, field.name) = @field(@field(configCommands, setterName), field.name);
+                    try self.applyConfig(newConfig);
+                    return;
                 }
-                return error.UnknownConfigField;
             }
+            return error.UnknownConfigField;
         } else {
             @panic("config command has to start with \"set\" or \"get\".");
         }
@@ -218,6 +274,8 @@ pub const Controller = struct {
                     try self.changeState(&self.mapTrack.controllerState);
                 } else if (std.mem.eql(u8, s.mode, "optimalselfdrive")) {
                     try self.changeState(&self.optimalSelfDrive.controllerState);
+                } else if (std.mem.eql(u8, s.mode, "adaptiveselfdrive")) {
+                    try self.changeState(&self.adaptiveSelfDrive.controllerState);
                 } else {
                     const buffer = try std.fmt.allocPrintSentinel(self.arena.allocator(), "{s}", .{s.mode}, 0);
                     utils.espLog(esp.ESP_LOG_WARN, tag, "Mode \"%s\"doesn't exist", buffer.ptr);
@@ -227,6 +285,15 @@ pub const Controller = struct {
             .restart => |_| {
                 return error.RestartCommand;
             },
+            .getConfig => |_| {
+                try self.telemetry.send(clientContract.ConfigSnapshot, self.config.*);
+            },
+            .applyConfig => |newConfig| {
+                try self.applyConfig(newConfig);
+            },
+            .saveConfig => |_| {
+                try self.saveConfig();
+            },
             .config => |configCommand| {
                 switch (configCommand.configCommands) {
                     else => {
@@ -240,6 +307,36 @@ pub const Controller = struct {
         try self.state.handleCommand(self, command);
     }
 
+    /// Invalid configs are rejected with a log, the config is only stored in the flash memory with the save command.
+    fn applyConfig(self: *Self, newConfig: Config) !void {
+        newConfig.validate(rtos.rtosTickPeriodMillis()) catch |err| {
+            const log: clientContract.Log = .{
+                .level = clientContract.LogLevel.err,
+                .message = try std.fmt.allocPrint(self.arena.allocator(), "Rejected the config: {s}", .{@errorName(err)}),
+            };
+            try self.telemetry.send(clientContract.Log, log);
+            return;
+        };
+        const deltaTimeChanged = newConfig.deltaTimeMs != self.config.deltaTimeMs;
+        self.config.* = newConfig;
+        if (deltaTimeChanged) {
+            if (self.localizer) |*localizer| {
+                localizer.deltaTimeChanged();
+            }
+        }
+    }
+
+    /// A failed write is only logged, so it doesn't stop the control loop.
+    fn saveConfig(self: *Self) !void {
+        configStorage.save(self.config) catch {
+            const log: clientContract.Log = .{ .level = clientContract.LogLevel.err, .message = "Storing the config in the flash memory failed." };
+            try self.telemetry.send(clientContract.Log, log);
+            return;
+        };
+        const log: clientContract.Log = .{ .level = clientContract.LogLevel.info, .message = "Stored the config in the flash memory." };
+        try self.telemetry.send(clientContract.Log, log);
+    }
+
     pub fn changeState(self: *Self, newState: *ControllerState) ControllerStateError!void {
         try self.state.reset(self);
         self.state = newState;
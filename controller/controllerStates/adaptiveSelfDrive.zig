@@ -0,0 +1,164 @@
+const std = @import("std");
+
+const Controller = @import("../controller.zig").Controller;
+const c = @import("controllerState.zig");
+const ControllerState = c.ControllerState;
+const ControllerStateError = c.ControllerStateError;
+const serverContract = @import("serverContract");
+const clientContract = @import("clientContract");
+const pwm = @cImport(@cInclude("pwm.h"));
+const placement = @import("placement");
+const Localizer = @import("../localizer.zig").Localizer;
+const SelfDrive = @import("selfDrive.zig").SelfDrive;
+const trackMod = @import("track");
+const Track = trackMod.Track(true);
+
+/// Drives with the map when the localizer is confident about the position on the track,
+/// otherwise it falls back to braking reactively on the IMU like SelfDrive.
+/// Everything depending on the track and the config is computed in start, so a step only does
+/// a few table lookups.
+pub const AdaptiveSelfDrive = struct {
+    const Self = @This();
+    const profileSamples = 256;
+    const curvatureBins = 16;
+    const speedBins = 16;
+
+    controllerState: ControllerState,
+    reactive: SelfDrive,
+    mapBased: bool,
+    // Maximum absolute curvature in degrees per meter of every section of the track.
+    curvatureProfile: [profileSamples]f32,
+    sampleDistance: f32,
+    maxCurvature: f32,
+    // Duty indexed by the curvature ahead and the current velocity.
+    dutyTable: [curvatureBins][speedBins]f32,
+
+    pub fn init() Self {
+        return .{
+            .controllerState = .{ .startFn = start, .stepFn = step, .handleCommandFn = handleCommand, .resetFn = reset },
+            .reactive = SelfDrive.init(),
+            .mapBased = false,
+            .curvatureProfile = [_]f32{0.0} ** profileSamples,
+            .sampleDistance = 1.0,
+            .maxCurvature = 0.0,
+            .dutyTable = [_][speedBins]f32{[_]f32{0.0} ** speedBins} ** curvatureBins,
+        };
+    }
+
+    pub fn start(controllerState: *ControllerState, controller: *Controller) ControllerStateError!void {
+        const self: *AdaptiveSelfDrive = @fieldParentPtr("controllerState", controllerState);
+        self.mapBased = false;
+        try self.reactive.controllerState.start(controller);
+        if (controller.track) |*track| {
+            self.computeCurvatureProfile(track);
+        } else {
+            controller.telemetry.send(clientContract.Log, clientContract.Log{ .level = clientContract.LogLevel.warning, .message = "There is no track mapping, only braking reactively." }) catch return ControllerStateError.SendFailed;
+        }
+        self.computeDutyTable(controller);
+    }
+
+    fn computeCurvatureProfile(self: *Self, track: *Track) void {
+        self.sampleDistance = track.getTrackLength() / profileSamples;
+        self.curvatureProfile = [_]f32{0.0} ** profileSamples;
+        const trackPoints = track.trackPoints;
+        for (trackPoints[0 .. trackPoints.len - 1], trackPoints[1..]) |prevTrackPoint, trackPoint| {
+            const segmentLength = track.minDifferenceDistances(trackPoint.distance, prevTrackPoint.distance);
+            if (segmentLength == 0.0) {
+                continue;
+            }
+            const curvature = @abs(Track.angularDelta(prevTrackPoint.heading, trackPoint.heading) / segmentLength);
+            const first = self.sampleIndex(prevTrackPoint.distance);
+            const last = self.sampleIndex(trackPoint.distance);
+            var i = first;
+            while (true) : (i = (i + 1) % profileSamples) {
+                self.curvatureProfile[i] = @max(self.curvatureProfile[i], curvature);
+                if (i == last) break;
+            }
+        }
+        self.maxCurvature = std.mem.max(f32, &self.curvatureProfile);
+    }
+
+    fn computeDutyTable(self: *Self, controller: *Controller) void {
+        const conf = controller.config;
+        for (0..curvatureBins) |curvatureBin| {
+            const curvatureDegreesPerM = self.binCurvature(curvatureBin);
+            const curvatureRadiansPerM = std.math.degreesToRadians(curvatureDegreesPerM);
+            // v = sqrt(a_lat / curvature), the velocity at which the lateral acceleration is at its limit.
+            const targetVelocity = if (curvatureRadiansPerM > 0.0) @min(conf.maxVelocityMPerS, @sqrt(conf.maxLateralAccelerationMPerS2 / curvatureRadiansPerM)) else conf.maxVelocityMPerS;
+            for (0..speedBins) |speedBin| {
+                const velocity = binVelocity(conf.maxVelocityMPerS, speedBin);
+                const feedForward = targetVelocity / conf.maxVelocityMPerS;
+                const factor = std.math.clamp(feedForward + conf.velocityGain * (targetVelocity - velocity) / conf.maxVelocityMPerS, 0.0, 1.0);
+                self.dutyTable[curvatureBin][speedBin] = conf.maxPwm * factor;
+            }
+        }
+    }
+
+    fn sampleIndex(self: *const Self, distance: f32) usize {
+        const index: usize = @intFromFloat(@max(0.0, distance / self.sampleDistance));
+        return index % profileSamples;
+    }
+
+    fn binCurvature(self: *const Self, bin: usize) f32 {
+        return self.maxCurvature * @as(f32, @floatFromInt(bin)) / (curvatureBins - 1);
+    }
+
+    fn binVelocity(maxVelocity: f32, bin: usize) f32 {
+        return maxVelocity * @as(f32, @floatFromInt(bin)) / (speedBins - 1);
+    }
+
+    fn toBin(value: f32, maxValue: f32, comptime bins: usize) usize {
+        if (maxValue <= 0.0) {
+            return 0;
+        }
+        const bin: usize = @intFromFloat(std.math.clamp(value / maxValue * (bins - 1) + 0.5, 0.0, bins - 1));
+        return bin;
+    }
+
+    /// Hysteresis between the two modes, so the car doesn't toggle when the variance is around the threshold.
+    fn updateMode(self: *Self, controller: *Controller, localizer: *const Localizer) ControllerStateError!void {
+        const distanceVariance = localizer.getDistanceVariance();
+        const threshold = controller.config.maxLocalizationVariance;
+        if (!self.mapBased and distanceVariance < threshold) {
+            self.mapBased = true;
+            controller.telemetry.send(clientContract.Log, clientContract.Log{ .level = clientContract.LogLevel.info, .message = "Localization is confident, driving with the map." }) catch return ControllerStateError.SendFailed;
+        } else if (self.mapBased and distanceVariance > 2.0 * threshold) {
+            self.mapBased = false;
+            try self.reactive.controllerState.reset(controller);
+            controller.telemetry.send(clientContract.Log, clientContract.Log{ .level = clientContract.LogLevel.warning, .message = "Localization is not confident, braking reactively." }) catch return ControllerStateError.SendFailed;
+        }
+    }
+
+    pub fn step(controllerState: *ControllerState, controller: *Controller) linksection(placement.hotText("adaptiveSelfDrive.step")) ControllerStateError!void {
+        const self: *AdaptiveSelfDrive = @fieldParentPtr("controllerState", controllerState);
+        if (controller.localizer == null or controller.track == null) {
+            return self.reactive.controllerState.step(controller);
+        }
+        const localizer: *Localizer = &controller.localizer.?;
+        try self.updateMode(controller, localizer);
+        if (!self.mapBased) {
+            return self.reactive.controllerState.step(controller);
+        }
+
+        const conf = controller.config;
+        const distance = localizer.getDistance();
+        const velocity = @max(0.0, localizer.getVelocity());
+        const lookaheadDistance = distance + conf.lookaheadMinM + velocity * conf.lookaheadTimeS;
+        // The car has to be slow enough for the sharper of the current and the upcoming section.
+        const curvature = @max(self.curvatureProfile[self.sampleIndex(distance)], self.curvatureProfile[self.sampleIndex(lookaheadDistance)]);
+        const duty = self.dutyTable[toBin(curvature, self.maxCurvature, curvatureBins)][toBin(velocity, conf.maxVelocityMPerS, speedBins)];
+        pwm.setDuty(@intFromFloat(duty));
+
+        if (controller.telemetry.due(.carTrackPoint, controller.config.deltaTimeMs)) {
+            controller.telemetry.send(clientContract.CarTrackPoint, clientContract.CarTrackPoint{ .distance = distance, .heading = localizer.getHeading(), .velocity = velocity }) catch return ControllerStateError.SendFailed;
+        }
+    }
+
+    pub fn reset(controllerState: *ControllerState, controller: *Controller) ControllerStateError!void {
+        const self: *AdaptiveSelfDrive = @fieldParentPtr("controllerState", controllerState);
+        self.mapBased = false;
+        try self.reactive.controllerState.reset(controller);
+    }
+
+    pub fn handleCommand(_: *ControllerState, _: *Controller, _: serverContract.command) ControllerStateError!void {}
+};
@@ -9,7 +9,7 @@ const clientContract = @import("clientContract");
 const trackMod = @import("track");
 const Track = trackMod.Track(true);
 const TrackPoint = trackMod.TrackPoint;
-const KalmanFilter = @import("../kalmanFilter.zig").KalmanFilter;
+const Localizer = @import("../localizer.zig").Localizer;
 const pwm = @cImport(@cInclude("pwm.h"));
 
 pub const MapTrack = struct {
@@ -33,9 +33,12 @@ pub const MapTrack = struct {
             track.deinit();
         }
         controller.track = null;
-        controller.kalmanFilter = null;
+        if (controller.localizer) |*localizer| {
+            localizer.deinit();
+        }
+        controller.localizer = null;
         self.trackPoints = std.ArrayList(TrackPoint).initCapacity(controller.allocator, 100) catch return ControllerStateError.OutOfMemory;
-        controller.netServer.send(clientContract.command, clientContract.command{.resetMapping = clientContract.resetMapping{}}) catch return ControllerStateError.SendFailed;
+        controller.telemetry.send(clientContract.command, clientContract.command{.resetMapping = clientContract.resetMapping{}}) catch return ControllerStateError.SendFailed;
         self.initialTrackPoint = null;
     }
 
@@ -65,7 +68,7 @@ pub const MapTrack = struct {
             controller.allocator,
             trackPoint,
         ) catch return ControllerStateError.OutOfMemory;
-        controller.netServer.send(TrackPoint, trackPoint) catch return ControllerStateError.SendFailed;
+        controller.telemetry.send(TrackPoint, trackPoint) catch return ControllerStateError.SendFailed;
     }
 
     pub fn handleCommand(controllerState: *ControllerState, controller: *Controller, command: serverContract.command) ControllerStateError!void {
@@ -73,13 +76,13 @@ pub const MapTrack = struct {
         switch (command) {
             .endMapping => {
                 if (self.trackPoints.items.len <= 3) {
-                    controller.netServer.send(clientContract.Log, clientContract.Log{.level = clientContract.LogLevel.warning, .message = "There must be at least three trackPoints to create a track. The track mapping will be reset and the mode is set to stop."}) catch return ControllerStateError.SendFailed;
-                    controller.netServer.send(clientContract.command, clientContract.command{.resetMapping = clientContract.resetMapping{}}) catch return ControllerStateError.SendFailed;
+                    controller.telemetry.send(clientContract.Log, clientContract.Log{.level = clientContract.LogLevel.warning, .message = "There must be at least three trackPoints to create a track. The track mapping will be reset and the mode is set to stop."}) catch return ControllerStateError.SendFailed;
+                    controller.telemetry.send(clientContract.command, clientContract.command{.resetMapping = clientContract.resetMapping{}}) catch return ControllerStateError.SendFailed;
                     self.trackPoints.deinit(controller.allocator);
                 } else {
                     controller.track = Track.init(controller.allocator, self.trackPoints.toOwnedSlice(controller.allocator) catch return ControllerStateError.OutOfMemory) catch return ControllerStateError.TrackCreationFailed;
-                    controller.kalmanFilter = KalmanFilter.init(controller, &controller.track.?);
-                    controller.netServer.send(clientContract.command, clientContract.command{.endMapping = clientContract.endMapping{}}) catch return ControllerStateError.SendFailed;
+                    controller.localizer = Localizer.init(controller, &controller.track.?, self.initialTrackPoint.?.heading) catch return ControllerStateError.OutOfMemory;
+                    controller.telemetry.send(clientContract.command, clientContract.command{.endMapping = clientContract.endMapping{}}) catch return ControllerStateError.SendFailed;
                 }
                 try controller.changeState(&controller.stop.controllerState);
             },
@@ -5,7 +5,7 @@ const ControllerStateError = c.ControllerStateError;
 const serverContract = @import("serverContract");
 const clientContract = @import("clientContract");
 const pwm = @cImport(@cInclude("pwm.h"));
-const KalmanFilter = @import("../kalmanFilter.zig").KalmanFilter;
+const Localizer = @import("../localizer.zig").Localizer;
 const trackMod = @import("track");
 const Track = trackMod.Track(true);
 const TrackPoint = trackMod.TrackPoint;
@@ -28,16 +28,18 @@ pub const OptimalSelfDrive = struct {
     }
 
     pub fn step(_: *ControllerState, controller: *Controller) ControllerStateError!void {
-        if (controller.kalmanFilter == null or controller.track == null) {
+        if (controller.localizer == null or controller.track == null) {
             try controller.changeState(&controller.stop.controllerState);
-            controller.netServer.send(clientContract.Log, clientContract.Log{.level = clientContract.LogLevel.warning, .message = "There is no track mapping, changing state to stop."}) catch return ControllerStateError.SendFailed;
+            controller.telemetry.send(clientContract.Log, clientContract.Log{.level = clientContract.LogLevel.warning, .message = "There is no track mapping, changing state to stop."}) catch return ControllerStateError.SendFailed;
             return;
         }
         pwm.setDuty(controller.config.dutyMapTrack);
-        const kalmanFilter: *KalmanFilter = &controller.kalmanFilter.?;
+        const localizer: *Localizer = &controller.localizer.?;
         const track: *Track = &controller.track.?;
-        const heading = track.distanceToHeading(kalmanFilter.distance);
-        controller.netServer.send(clientContract.CarTrackPoint, clientContract.CarTrackPoint{.distance = kalmanFilter.distance, .heading = heading}) catch return ControllerStateError.SendFailed;
+        const heading = track.distanceToHeading(localizer.getDistance());
+        if (controller.telemetry.due(.carTrackPoint, controller.config.deltaTimeMs)) {
+            controller.telemetry.send(clientContract.CarTrackPoint, clientContract.CarTrackPoint{.distance = localizer.getDistance(), .heading = heading, .velocity = localizer.getVelocity()}) catch return ControllerStateError.SendFailed;
+        }
     }
 
     pub fn reset(controllerState: *ControllerState, _: *Controller) ControllerStateError!void {
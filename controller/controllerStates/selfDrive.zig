@@ -4,6 +4,8 @@ const ControllerState = c.ControllerState;
 const ControllerStateError = c.ControllerStateError;
 const serverContract = @import("serverContract");
 const pwm = @cImport(@cInclude("pwm.h"));
+const placement = @import("placement");
+const brakeLaw = @import("brakeLaw");
 
 // TODO: remove
 const utilsZig = @import("../utils.zig");
@@ -31,19 +33,14 @@ pub const SelfDrive = struct {
         _ = controller;
     }
 
-    pub fn step(controllerState: *ControllerState, controller: *Controller) ControllerStateError!void {
+    pub fn step(controllerState: *ControllerState, controller: *Controller) linksection(placement.hotText("selfDrive.step")) ControllerStateError!void {
         const self: *SelfDrive = @fieldParentPtr("controllerState", controllerState);
         const conf = controller.config;
 
-        const brake = @abs(controller.bmi.prevGyro.y) * conf.gyroBrakeMultiplier + @abs(controller.bmi.prevAccel.y) * conf.accelBrakeMultiplier;
-        const iirFilterCoefficient = if (brake > self.prevBrake) conf.iirFilterRiseCoefficient else conf.iirFilterFallCoefficient;
-        const filteredBrakeUncapped = (1 - iirFilterCoefficient) * self.prevBrake + iirFilterCoefficient * brake;
-        const filteredBrake = if (filteredBrakeUncapped > 100.0) 100.0 else filteredBrakeUncapped;
-        const factor = 1 - (filteredBrake / 100.0);
+        const brakeStep = brakeLaw.step(conf, self.prevBrake, controller.bmi.prevGyro.y, controller.bmi.prevAccel.y);
+        self.prevBrake = brakeStep.brake;
 
-        self.prevBrake = filteredBrake;
-
-        pwm.setDuty(@intFromFloat(conf.maxPwm * factor));
+        pwm.setDuty(@intFromFloat(brakeStep.duty));
 
         // TODO: remove
         //controller.bmi.update() catch unreachable;
@@ -51,11 +48,11 @@ pub const SelfDrive = struct {
         //const measurement: clientContract.Measurement = .{
         //    .time = time / 1_000.0,
         //    .heading = conf.maxPwm * controller.bmi.heading,
-        //    .accelerationX = factor,
+        //    .accelerationX = brakeStep.duty / conf.maxPwm,
         //    .accelerationY = 0,
         //    .accelerationZ = 0,
         //};
-        //controller.netServer.send(clientContract.Measurement, measurement) catch unreachable;
+        //controller.telemetry.send(clientContract.Measurement, measurement) catch unreachable;
     }
 
     pub fn reset(controllerState: *ControllerState, _: *Controller) ControllerStateError!void {
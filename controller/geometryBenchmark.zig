@@ -0,0 +1,131 @@
+const std = @import("std");
+const kdTreeMod = @import("kdTree");
+const icpMod = @import("icp");
+const TrackPoint = @import("track").TrackPoint;
+const sineTrack = @import("track").sineTrack;
+const utilsZig = @import("utils.zig");
+
+const utils = @cImport(@cInclude("utils.h"));
+const rtos = @cImport(@cInclude("rtos.h"));
+
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const tag = "geometry benchmark";
+const pointCount = 721;
+const queryCount = 2000;
+const icpSourceCount = 100;
+const icpIterations = 3;
+
+/// TrackPoint in double precision, like it was before the kd tree and icp were generic over the scalar type.
+/// The esp has no FPU, f32 is emulated in software too, but the f64 routines are slower.
+const TrackPoint64 = struct {
+    distance: f64,
+    heading: f64,
+
+    const Self = @This();
+
+    pub fn init(distance: f64, heading: f64) Self {
+        return .{ .distance = distance, .heading = heading };
+    }
+
+    pub fn getX(self: Self) f64 {
+        return self.distance;
+    }
+
+    pub fn getY(self: Self) f64 {
+        return self.heading;
+    }
+
+    fn minDifferenceDistances(a: f64, b: f64) f64 {
+        const d = @abs(a - b);
+        return @min(d, @max(0, 7.21 - d));
+    }
+
+    fn minDifferenceAngle(a: f64, b: f64) f64 {
+        const d = @abs(a - b);
+        return @min(d, 360.0 - d);
+    }
+
+    pub fn distanceNoRoot(self: Self, point: Self) f64 {
+        const distanceDiff = minDifferenceDistances(point.distance, self.distance);
+        const headingDiff = minDifferenceAngle(point.heading, self.heading) * 0.01;
+        return distanceDiff * distanceDiff + headingDiff * headingDiff;
+    }
+
+    pub fn getDimension(self: Self, dimension: usize) f64 {
+        if (dimension == 0) {
+            return self.distance;
+        } else if (dimension == 1) {
+            return self.heading;
+        }
+        unreachable;
+    }
+};
+
+const Result = struct {
+    nearestNeighborMicros: f64,
+    icpMicros: f64,
+};
+
+/// Times the nearest neighbor search and icp on the same track as the positioning test (a sine of the heading over 7.2 m).
+fn measure(comptime pointT: type, allocator: std.mem.Allocator) !Result {
+    const scalarT = kdTreeMod.Scalar(pointT);
+    const points = try allocator.alloc(pointT, pointCount);
+    defer allocator.free(points);
+    for (points, 0..) |*point, i| {
+        const distance = sineTrack.distance(scalarT, i, pointCount);
+        point.* = pointT.init(distance, sineTrack.heading(scalarT, distance));
+    }
+    const kdTree = try kdTreeMod.KdTree(pointT, 2).init(allocator, points);
+    defer kdTree.deinit();
+
+    var prng = std.Random.DefaultPrng.init(0);
+    const rng = prng.random();
+    const queries = try allocator.alloc(pointT, queryCount);
+    defer allocator.free(queries);
+    for (queries) |*query| {
+        query.* = pointT.init(rng.float(scalarT) * sineTrack.length, rng.float(scalarT) * 360.0);
+    }
+
+    var checksum: scalarT = 0;
+    var start = utilsZig.timestampMicros();
+    for (queries) |query| {
+        checksum += kdTree.nearestNeighbor(query).?.getX();
+    }
+    const nearestNeighborMicros = utilsZig.timestampMicros() - start;
+
+    const icp = icpMod.Icp(pointT).init(queries[0..icpSourceCount], &kdTree, icpIterations);
+    start = utilsZig.timestampMicros();
+    checksum += icp.icp();
+    const icpMicros = utilsZig.timestampMicros() - start;
+    std.mem.doNotOptimizeAway(checksum);
+
+    return .{
+        .nearestNeighborMicros = @as(f64, @floatFromInt(nearestNeighborMicros)) / queryCount,
+        .icpMicros = @floatFromInt(icpMicros),
+    };
+}
+
+/// Runs the benchmark in a task of its own with the highest priority, so neither the control task nor the net task
+/// preempt the measurement, only interrupts do. The car stands still meanwhile.
+pub fn start() void {
+    var name = [_]u8{ 'b', 'e', 'n', 'c', 'h', 'm', 'a', 'r', 'k', 0 };
+    rtos.rtosXTaskCreate(runTask, &name, 8000, null, rtos.rtosMaxPriority());
+}
+
+fn runTask(_: ?*anyopaque) callconv(.c) void {
+    run(std.heap.raw_c_allocator) catch |err| {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Benchmark failed with error: %s", @errorName(err).ptr);
+    };
+    rtos.rtosVTaskDeleteSelf();
+}
+
+/// Compares the kd tree and icp with single and double precision track points on the target.
+fn run(allocator: std.mem.Allocator) !void {
+    const single = try measure(TrackPoint, allocator);
+    const double = try measure(TrackPoint64, allocator);
+    utils.espLog(esp.ESP_LOG_INFO, tag, "nearest neighbor: f32 %.2f us, f64 %.2f us per query", single.nearestNeighborMicros, double.nearestNeighborMicros);
+    utils.espLog(esp.ESP_LOG_INFO, tag, "icp (%d points, %d iterations): f32 %.0f us, f64 %.0f us", @as(c_int, icpSourceCount), @as(c_int, icpIterations), single.icpMicros, double.icpMicros);
+}
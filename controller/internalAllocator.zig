@@ -0,0 +1,40 @@
+const std = @import("std");
+
+const esp = @cImport({
+    @cInclude("esp_heap_caps.h");
+});
+
+/// Allocates from internal DRAM only, so the track and the kd tree which are read every control step
+/// never end up in memory that is accessed through the flash/psram cache.
+pub const InternalAllocator = struct {
+    const caps = esp.MALLOC_CAP_INTERNAL | esp.MALLOC_CAP_8BIT;
+
+    pub fn allocator() std.mem.Allocator {
+        return .{
+            .ptr = undefined,
+            .vtable = &.{
+                .alloc = alloc,
+                .resize = resize,
+                .remap = remap,
+                .free = free,
+            },
+        };
+    }
+
+    fn alloc(_: *anyopaque, len: usize, alignment: std.mem.Alignment, _: usize) ?[*]u8 {
+        const ptr = esp.heap_caps_aligned_alloc(alignment.toByteUnits(), len, caps) orelse return null;
+        return @ptrCast(ptr);
+    }
+
+    fn resize(_: *anyopaque, memory: []u8, _: std.mem.Alignment, newLen: usize, _: usize) bool {
+        return newLen <= memory.len;
+    }
+
+    fn remap(_: *anyopaque, _: []u8, _: std.mem.Alignment, _: usize, _: usize) ?[*]u8 {
+        return null;
+    }
+
+    fn free(_: *anyopaque, memory: []u8, _: std.mem.Alignment, _: usize) void {
+        esp.heap_caps_free(memory.ptr);
+    }
+};
@@ -2,9 +2,17 @@ const std = @import("std");
 const trackMod = @import("track");
 const Track = trackMod.Track(true);
 const TrackPoint = trackMod.TrackPoint;
+const HeadingWindow = trackMod.HeadingWindow;
+const RelocalizationCandidate = trackMod.RelocalizationCandidate;
+const clientContract = @import("clientContract");
 const Controller = @import("controller.zig").Controller;
 const mat = @import("matrix");
+const placement = @import("placement");
 
+const initialPMat = [_][2]f32{
+    .{ 0.5, 0.0 },
+    .{ 0.0, 0.1 },
+};
 
 pub const KalmanFilter = struct {
     const Self = @This();
@@ -18,24 +26,27 @@ pub const KalmanFilter = struct {
     fMat: [2][2]f32,
     qMat: [2][2]f32,
     rMat: [2][2]f32,
+    headingWindow: HeadingWindow,
+    largeInnovationTicks: u32,
+
+    // with acceleration F = [1, dt, 1/2 dt*dt; 0, 1, dt]
+    fn transitionMatrix(deltaTimeMs: u32) [2][2]f32 {
+        const dtMs: f32 = @floatFromInt(deltaTimeMs);
+        return [_][2]f32{
+            .{ 1.0, dtMs / 1000 },
+            .{ 0.0, 1.0 },
+        };
+    }
 
     pub fn init(controller: *Controller, track: *Track) Self {
-        const dtMs: f32 = @floatFromInt(controller.config.deltaTimeMs);
         return .{
             .controller = controller,
             .track = track,
             .distance = 0.0,
             .velocity = 0.0,
             .heading = 0.0,
-            .pMat = [_][2]f32{
-                .{ 0.5, 0.0 },
-                .{ 0.0, 0.1 },
-            },
-            // with acceleration F = [1, dt, 1/2 dt*dt; 0, 1, dt]
-            .fMat = [_][2]f32{
-                .{ 1.0, dtMs / 1000 }, 
-                .{ 0.0, 1.0 },
-            },
+            .pMat = initialPMat,
+            .fMat = transitionMatrix(controller.config.deltaTimeMs),
             // TODO: tune
             .qMat = [_][2]f32{
                 .{ 0.5, 0.0 },
@@ -45,17 +56,23 @@ pub const KalmanFilter = struct {
                 .{ 0.5, 0.0 }, 
                 .{ 0.0, 0.1 },
             },
+            .headingWindow = HeadingWindow.init(),
+            .largeInnovationTicks = 0,
         };
     }
 
-    fn distanceMeasurementThroughHeading(self: *Self, xVecPred: [2]f32) f32 {
+    pub fn deltaTimeChanged(self: *Self) void {
+        self.fMat = transitionMatrix(self.controller.config.deltaTimeMs);
+    }
+
+    fn distanceMeasurementThroughHeading(self: *Self, xVecPred: [2]f32) linksection(placement.hotText("kalmanFilter.distanceMeasurementThroughHeading")) f32 {
         const dtMs: f32 = @floatFromInt(self.controller.config.deltaTimeMs);
         const measuredHeading = @mod(self.heading + self.controller.bmi.prevGyro.z * dtMs / 1000 , 360);
         const trackPoint: TrackPoint = .{.distance = xVecPred[0], .heading = measuredHeading};
         return self.track.getClosestPointInterpolated(trackPoint).distance;
     }
 
-    pub fn update(self: *Self) void {
+    pub fn update(self: *Self) linksection(placement.hotText("kalmanFilter.update")) void {
         const prevXVec: [2]f32 = [2]f32{ self.distance, self.velocity };
         var xVecPred: [2]f32 = mat.vectorMultiply(2, 2, self.fMat, prevXVec);
         xVecPred[0] = @mod(xVecPred[0], self.track.getTrackLength());
@@ -82,5 +99,30 @@ pub const KalmanFilter = struct {
         };
         self.pMat = mat.multiply(2, 2, 2, mat.addWithCoefficients(2, 2, 1, -1, identity, mat.multiply(2, 2, 2, kMat, hMat)), pMatPrediction);
         self.heading = self.track.distanceToHeading(self.distance);
+
+        self.headingWindow.update(self.controller.tacho.distance, self.controller.bmi.heading);
+        if (@abs(yVec[0]) > self.controller.config.relocalizationInnovationM) {
+            self.largeInnovationTicks += 1;
+        } else {
+            self.largeInnovationTicks = 0;
+        }
+        if (self.largeInnovationTicks >= self.controller.config.relocalizationTicks) {
+            self.relocalize();
+        }
+    }
+
+    /// Reseeds the filter at the best match of the recent heading changes, when the measurements kept disagreeing
+    /// with the prediction, for example after the car deslotted or was put back onto the track.
+    fn relocalize(self: *Self) void {
+        self.largeInnovationTicks = 0;
+        var candidates: [3]RelocalizationCandidate = undefined;
+        const found = self.track.relocalize(&self.headingWindow, &candidates);
+        if (found.len == 0 or found[0].confidence < self.controller.config.minRelocalizationConfidence) {
+            return;
+        }
+        self.distance = found[0].distance;
+        self.heading = self.track.distanceToHeading(self.distance);
+        self.pMat = initialPMat;
+        self.controller.telemetry.send(clientContract.Log, .{ .level = clientContract.LogLevel.info, .message = "Relocalized with the heading signature of the track." }) catch {};
     }
 };
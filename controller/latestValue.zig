@@ -0,0 +1,63 @@
+const std = @import("std");
+
+/// Holds only the newest value written by one producer task, older values which the consumer
+/// didn't take yet are overwritten (counted as coalesced).
+/// It is a sequence lock with atomic loads and stores only, so it works on cores without
+/// atomic read-modify-write instructions. T can have at most 32 bits (for example f32).
+pub fn LatestValue(comptime T: type) type {
+    if (@bitSizeOf(T) > 32) {
+        @compileError("LatestValue only supports types of at most 32 bits.");
+    }
+    const BitsT = std.meta.Int(.unsigned, @bitSizeOf(T));
+    return struct {
+        const Self = @This();
+
+        pub const Taken = struct {
+            value: T,
+            receivedMicros: u32,
+            // Values that were overwritten before they were taken.
+            coalesced: u32,
+        };
+
+        // Odd while the producer writes.
+        sequence: std.atomic.Value(u32),
+        bits: std.atomic.Value(BitsT),
+        receivedMicros: std.atomic.Value(u32),
+        takenSequence: u32,
+
+        pub fn init() Self {
+            return .{
+                .sequence = std.atomic.Value(u32).init(0),
+                .bits = std.atomic.Value(BitsT).init(0),
+                .receivedMicros = std.atomic.Value(u32).init(0),
+                .takenSequence = 0,
+            };
+        }
+
+        /// Called by the producer.
+        pub fn put(self: *Self, value: T, receivedMicros: u32) void {
+            const sequence = self.sequence.raw;
+            self.sequence.store(sequence +% 1, .monotonic);
+            self.bits.store(@bitCast(value), .release);
+            self.receivedMicros.store(receivedMicros, .release);
+            self.sequence.store(sequence +% 2, .release);
+        }
+
+        /// Called by the consumer, returns null if there is no new value.
+        /// Doesn't wait when the producer is interrupted while writing, the value is taken on the next call instead.
+        pub fn take(self: *Self) ?Taken {
+            const sequence = self.sequence.load(.acquire);
+            if (sequence == self.takenSequence or sequence % 2 == 1) {
+                return null;
+            }
+            const bits = self.bits.load(.acquire);
+            const receivedMicros = self.receivedMicros.load(.acquire);
+            if (self.sequence.load(.monotonic) != sequence) {
+                return null;
+            }
+            const coalesced = (sequence -% self.takenSequence) / 2 - 1;
+            self.takenSequence = sequence;
+            return .{ .value = @bitCast(bits), .receivedMicros = receivedMicros, .coalesced = coalesced };
+        }
+    };
+}
@@ -0,0 +1,80 @@
+const std = @import("std");
+const trackMod = @import("track");
+const Track = trackMod.Track(true);
+const Config = @import("config").Config;
+const Controller = @import("controller.zig").Controller;
+const KalmanFilter = @import("kalmanFilter.zig").KalmanFilter;
+const ParticleLocalizer = @import("particleLocalizer.zig").ParticleLocalizer;
+const placement = @import("placement");
+
+pub const Kind = enum(u32) {
+    kalmanFilter = 0,
+    particleFilter = 1,
+};
+
+/// Estimates the distance of the car on the mapped track, the controller states only use this interface.
+pub const Localizer = union(Kind) {
+    const Self = @This();
+
+    kalmanFilter: KalmanFilter,
+    particleFilter: ParticleLocalizer,
+
+    pub fn kindFromConfig(config: *const Config) Kind {
+        return std.meta.intToEnum(Kind, config.localizer) catch .kalmanFilter;
+    }
+
+    /// headingOffset is the heading of the bmi at the start of the mapping.
+    pub fn init(controller: *Controller, track: *Track, headingOffset: f32) !Self {
+        return switch (kindFromConfig(controller.config)) {
+            .kalmanFilter => .{ .kalmanFilter = KalmanFilter.init(controller, track) },
+            .particleFilter => .{ .particleFilter = try ParticleLocalizer.init(controller, track, headingOffset) },
+        };
+    }
+
+    pub fn update(self: *Self) linksection(placement.hotText("localizer.update")) void {
+        switch (self.*) {
+            inline else => |*localizer| localizer.update(),
+        }
+    }
+
+    /// Called after config.deltaTimeMs changed while the localizer is running.
+    pub fn deltaTimeChanged(self: *Self) void {
+        switch (self.*) {
+            .kalmanFilter => |*kalmanFilter| kalmanFilter.deltaTimeChanged(),
+            // Reads the delta time from the config in every update.
+            .particleFilter => {},
+        }
+    }
+
+    pub fn getDistance(self: *const Self) f32 {
+        return switch (self.*) {
+            inline else => |localizer| localizer.distance,
+        };
+    }
+
+    pub fn getVelocity(self: *const Self) f32 {
+        return switch (self.*) {
+            inline else => |localizer| localizer.velocity,
+        };
+    }
+
+    pub fn getHeading(self: *const Self) f32 {
+        return switch (self.*) {
+            inline else => |localizer| localizer.heading,
+        };
+    }
+
+    pub fn getDistanceVariance(self: *const Self) f32 {
+        return switch (self.*) {
+            .kalmanFilter => |kalmanFilter| kalmanFilter.pMat[0][0],
+            .particleFilter => |*particleFilter| particleFilter.getDistanceVariance(),
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        switch (self.*) {
+            .kalmanFilter => {},
+            .particleFilter => |*particleFilter| particleFilter.deinit(),
+        }
+    }
+};
@@ -0,0 +1,67 @@
+const std = @import("std");
+
+const utilsZig = @import("utils.zig");
+const utils = @cImport(@cInclude("utils.h"));
+
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const tag = "loop timing";
+
+/// Measures how long a control step takes and how much the period between two steps jitters.
+/// The statistics are logged and reset every reportInterval steps.
+pub const LoopTiming = struct {
+    const Self = @This();
+    const reportInterval: u32 = 1000;
+
+    stepStartMicros: i64,
+    prevStepStartMicros: ?i64,
+    count: u32,
+    stepSumMicros: i64,
+    stepMaxMicros: i64,
+    periodMinMicros: i64,
+    periodMaxMicros: i64,
+
+    pub fn init() Self {
+        return .{
+            .stepStartMicros = 0,
+            .prevStepStartMicros = null,
+            .count = 0,
+            .stepSumMicros = 0,
+            .stepMaxMicros = 0,
+            .periodMinMicros = std.math.maxInt(i64),
+            .periodMaxMicros = 0,
+        };
+    }
+
+    pub fn startStep(self: *Self) void {
+        self.stepStartMicros = utilsZig.timestampMicros();
+        if (self.prevStepStartMicros) |prevStepStartMicros| {
+            const period = self.stepStartMicros - prevStepStartMicros;
+            self.periodMinMicros = @min(self.periodMinMicros, period);
+            self.periodMaxMicros = @max(self.periodMaxMicros, period);
+        }
+        self.prevStepStartMicros = self.stepStartMicros;
+    }
+
+    pub fn endStep(self: *Self) void {
+        const stepMicros = utilsZig.timestampMicros() - self.stepStartMicros;
+        self.stepSumMicros += stepMicros;
+        self.stepMaxMicros = @max(self.stepMaxMicros, stepMicros);
+        self.count += 1;
+
+        if (self.count < reportInterval) {
+            return;
+        }
+        const stepAvgMicros: c_int = @intCast(@divTrunc(self.stepSumMicros, self.count));
+        const stepMaxMicros: c_int = @intCast(self.stepMaxMicros);
+        const periodMinMicros: c_int = @intCast(self.periodMinMicros);
+        const periodMaxMicros: c_int = @intCast(self.periodMaxMicros);
+        utils.espLog(esp.ESP_LOG_INFO, tag, "step avg %d us, max %d us; period min %d us, max %d us, jitter %d us", stepAvgMicros, stepMaxMicros, periodMinMicros, periodMaxMicros, periodMaxMicros - periodMinMicros);
+
+        const prevStepStartMicros = self.prevStepStartMicros;
+        self.* = init();
+        self.prevStepStartMicros = prevStepStartMicros;
+    }
+};
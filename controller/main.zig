@@ -9,13 +9,18 @@ const serverContract = @import("serverContract");
 
 const Config = @import("config").Config;
 const Bmi = @import("bmi.zig").Bmi;
-const Tacho = @import("tacho.zig").Tacho;
-const NetServer = @import("netServer.zig").NetServer;
+const tachoMod = @import("tacho.zig");
+const Tacho = tachoMod.Tacho;
+const configStorage = @import("configStorage.zig");
+const netTaskMod = @import("netTask.zig");
+const NetTask = netTaskMod.NetTask;
+const transportMod = @import("transport.zig");
+const InternalAllocator = @import("internalAllocator.zig").InternalAllocator;
+const placement = @import("placement");
 
 const rtos = @cImport(@cInclude("rtos.h"));
 const utils = @cImport(@cInclude("utils.h"));
 const i2c = @cImport(@cInclude("i2c.h"));
-const pt = @cImport(@cInclude("pt.h"));
 
 const c = @cImport({
     @cInclude("stdio.h");
@@ -42,23 +47,51 @@ pub fn panic(msg: []const u8, _: ?*@import("std").builtin.StackTrace, _: ?usize)
     }
 }
 
+const controlTaskPriority = 20;
+const netTaskPriority = 5;
+const uartConsolePriority = 1;
+const tachoStatisticsPriority = 1;
+
+var config: Config = undefined;
+var netTask: NetTask = undefined;
+var controller: Controller = undefined;
+
 export fn app_main() callconv(.c) void {
-    const allocator = std.heap.raw_c_allocator;
+    const allocator = if (placement.enabled) InternalAllocator.allocator() else std.heap.raw_c_allocator;
 
     utils.espErrorCheck(esp.nvs_flash_init());
 
     var name = [_]u8{ 'u', 'a', 'r', 't', ' ', 'c', 'o', 'n', 's', 'o', 'l', 'e', 0 };
-    rtos.rtosXTaskCreate(UartConsole.run, &name, 5000, null, 1);
+    rtos.rtosXTaskCreate(UartConsole.run, &name, 5000, null, uartConsolePriority);
 
-    esp.wifi_init();
+    // Chosen with the transport command of the uart console.
+    const transport = transportMod.load();
+    if (transport == .tcp) {
+        esp.wifi_init();
+    }
 
-    var config = Config.init();
+    config = Config.init();
+    const storedConfig = configStorage.load(allocator, &config) catch |err| blk: {
+        const buffer = std.fmt.allocPrintSentinel(allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
+        defer allocator.free(buffer);
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Loading the stored config failed with error: %s", buffer.ptr);
+        config = Config.init();
+        break :blk false;
+    };
+    if (storedConfig) {
+        utils.espLog(esp.ESP_LOG_INFO, tag, "Loaded the stored config");
+    } else {
+        utils.espLog(esp.ESP_LOG_INFO, tag, "No stored config, using the default config");
+    }
 
     pwm.pwmInit();
     utils.espLog(esp.ESP_LOG_INFO, tag, "Initialized motor control successfully");
 
-    pt.ptInit();
-    utils.espLog(esp.ESP_LOG_INFO, tag, "Initialized timer for measuring rotations successfully");
+    Tacho.initHardware();
+    switch (tachoMod.backend) {
+        .timer => utils.espLog(esp.ESP_LOG_INFO, tag, "Initialized timer for measuring rotations successfully"),
+        .pulseCounter => utils.espLog(esp.ESP_LOG_INFO, tag, "Initialized pulse counter for measuring rotations successfully"),
+    }
 
     var i2cBusHandle: esp.i2c_master_bus_handle_t = null;
     i2c.i2c_bus_init(&i2cBusHandle);
@@ -72,36 +105,50 @@ export fn app_main() callconv(.c) void {
 
     const tacho = Tacho.init(&config);
 
-    var controller: Controller = undefined;
-
     const port: u16 = 8080;
+    const baudRate: c_int = 2_000_000;
+    const endpoint: netTaskMod.Endpoint = switch (transport) {
+        .tcp => .{ .tcp = port },
+        .serial => .{ .serial = baudRate },
+    };
 
-    utils.espLog(esp.ESP_LOG_INFO, tag, "Waiting for connection...");
-    const netServer = NetServer(serverContract.ServerContractEnum, serverContract.ServerContract, Controller, clientContract.ClientContract).init(
-        allocator,
-        port,
-        &controller,
-    ) catch |err| {
+    utils.espLog(esp.ESP_LOG_INFO, tag, "Waiting for connection over %s...", @tagName(transport).ptr);
+    netTask.init(allocator, endpoint) catch |err| {
         const buffer = std.fmt.allocPrintSentinel(allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
         defer allocator.free(buffer);
-        utils.espLog(esp.ESP_LOG_ERROR, tag, "Initializing controller failed with error: %s", buffer.ptr);
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Initializing net task failed with error: %s", buffer.ptr);
         return;
     };
-    defer netServer.deinit();
     utils.espLog(esp.ESP_LOG_INFO, tag, "Client connected");
 
-    controller = Controller.init(allocator, &config, bmi, tacho, netServer) catch |err| {
+    controller = Controller.init(allocator, &config, bmi, tacho, &netTask) catch |err| {
         const buffer = std.fmt.allocPrintSentinel(allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
         defer allocator.free(buffer);
         utils.espLog(esp.ESP_LOG_ERROR, tag, "Initializing controller failed with error: %s", buffer.ptr);
+        netTask.deinit();
         return;
     };
     controller.afterInit();
-    defer controller.deinit();
 
+    // The WiFi and lwIP tasks run on core 0, so on chips with two cores the control loop gets the other one.
+    // On single core chips the priorities still let the control loop preempt networking.
+    const controlCore: c_int = if (rtos.rtosCoreCount() > 1) 1 else 0;
+    const netCore: c_int = 0;
+
+    var netName = [_]u8{ 'n', 'e', 't', 0 };
+    rtos.rtosXTaskCreatePinnedToCore(NetTask.run, &netName, 8000, &netTask, netTaskPriority, netCore);
+    var controlName = [_]u8{ 'c', 'o', 'n', 't', 'r', 'o', 'l', 0 };
+    rtos.rtosXTaskCreatePinnedToCore(runController, &controlName, 16000, null, controlTaskPriority, controlCore);
+    if (tachoMod.statisticsEnabled) {
+        var statisticsName = [_]u8{ 't', 'a', 'c', 'h', 'o', 0 };
+        rtos.rtosXTaskCreate(tachoMod.runStatisticsTask, &statisticsName, 3000, null, tachoStatisticsPriority);
+    }
+}
+
+fn runController(_: ?*anyopaque) callconv(.c) void {
     controller.run() catch |err| {
-        const buffer = std.fmt.allocPrintSentinel(allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
-        defer allocator.free(buffer);
+        const buffer = std.fmt.allocPrintSentinel(controller.allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
+        defer controller.allocator.free(buffer);
         utils.espLog(esp.ESP_LOG_ERROR, tag, "Running controller failed with error: %s", buffer.ptr);
     };
 
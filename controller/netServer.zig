@@ -18,7 +18,8 @@ const encode = @import("encode");
 
 const tag = "net server";
 
-pub fn NetServer(comptime serverContractEnumT: type, comptime serverContractT: type, comptime handlerT: type, comptime clientContractT: type) type {
+/// receiveBufferSize is the most that is read from the socket at once, recv reads until the socket would block.
+pub fn NetServer(comptime serverContractEnumT: type, comptime serverContractT: type, comptime handlerT: type, comptime clientContractT: type, comptime receiveBufferSize: usize) type {
     return struct {
         allocator: std.mem.Allocator,
 
@@ -30,7 +31,7 @@ pub fn NetServer(comptime serverContractEnumT: type, comptime serverContractT: t
         const Encoder = encode.Encoder(clientContractT);
 
         const Self = @This();
-        var buffer: [128]u8 = undefined;
+        var buffer: [receiveBufferSize]u8 = undefined;
 
         pub fn init(allocator: std.mem.Allocator, port: u16, handler: *handlerT) !Self {
             var listenerResult: esp.ListenerResult = .{ .server_fd = 0, .result = 0 };
@@ -51,17 +52,20 @@ pub fn NetServer(comptime serverContractEnumT: type, comptime serverContractT: t
             return .{ .allocator = allocator, .listener = listenerResult.server_fd, .connection = connectionResult.connection, .decoder = decoder };
         }
 
+        /// Reads and decodes until there is nothing left on the socket, so a burst of commands doesn't pile up.
         pub fn recv(self: *Self) !void {
-            var recvResult: esp.RecvResult = .{ .buffer = &buffer, .size = buffer.len, .result = 0, .bytesRead = 0 };
-            esp.non_blocking_recv(self.connection, &recvResult);
-            switch (recvResult.result) {
-                esp.WOULD_BLOCK => return,
-                esp.CONNECTION_CLOSED => return error.ConnectionClosed,
-                esp.UNKNOWN => {
-                    return error.RecvFailed;
-                },
-                esp.OK => try self.decoder.decode(buffer[0..@intCast(recvResult.bytesRead)]),
-                else => unreachable,
+            while (true) {
+                var recvResult: esp.RecvResult = .{ .buffer = &buffer, .size = buffer.len, .result = 0, .bytesRead = 0 };
+                esp.non_blocking_recv(self.connection, &recvResult);
+                switch (recvResult.result) {
+                    esp.WOULD_BLOCK => return,
+                    esp.CONNECTION_CLOSED => return error.ConnectionClosed,
+                    esp.UNKNOWN => {
+                        return error.RecvFailed;
+                    },
+                    esp.OK => try self.decoder.decode(buffer[0..@intCast(recvResult.bytesRead)]),
+                    else => unreachable,
+                }
             }
         }
 
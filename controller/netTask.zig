@@ -0,0 +1,257 @@
+const std = @import("std");
+
+const clientContract = @import("clientContract");
+const serverContract = @import("serverContract");
+const NetServer = @import("netServer.zig").NetServer;
+const SerialServer = @import("serialServer.zig").SerialServer;
+const Transport = @import("transport.zig").Transport;
+const SpscQueue = @import("spscQueue").SpscQueue;
+const LatestValue = @import("latestValue.zig").LatestValue;
+const CommandLatency = @import("commandLatency.zig").CommandLatency;
+const utilsZig = @import("utils.zig");
+
+const rtos = @cImport(@cInclude("rtos.h"));
+const utils = @cImport(@cInclude("utils.h"));
+
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const tag = "net task";
+
+pub const CommandQueue = SpscQueue(serverContract.command, 16);
+pub const TelemetryQueue = SpscQueue(clientContract.ClientContract, 64);
+pub const LatestSpeed = LatestValue(f32);
+const receiveBufferSize = 1024;
+
+pub const Stream = std.meta.FieldEnum(serverContract.subscribe);
+const streamCount = @typeInfo(Stream).@"enum".fields.len;
+
+/// The rates in Hz the client subscribed to, written by the net task and read by the control loop.
+pub const Subscriptions = struct {
+    const Self = @This();
+
+    rates: [streamCount]std.atomic.Value(u16),
+
+    pub fn init() Self {
+        var self: Self = .{ .rates = undefined };
+        self.set(.{ .measurement = std.math.maxInt(u16), .carTrackPoint = std.math.maxInt(u16) });
+        return self;
+    }
+
+    /// Replaces all rates, a stream missing in subscribe is switched off.
+    pub fn set(self: *Self, subscribe: serverContract.subscribe) void {
+        inline for (@typeInfo(serverContract.subscribe).@"struct".fields, 0..) |field, i| {
+            self.rates[i].store(@field(subscribe, field.name), .release);
+        }
+    }
+
+    pub fn rate(self: *const Self, stream: Stream) u16 {
+        return self.rates[@intFromEnum(stream)].load(.acquire);
+    }
+};
+
+pub const NetServerT = NetServer(serverContract.ServerContractEnum, serverContract.ServerContract, NetTask, clientContract.ClientContract, receiveBufferSize);
+pub const SerialServerT = SerialServer(serverContract.ServerContractEnum, serverContract.ServerContract, NetTask, clientContract.ClientContract, receiveBufferSize);
+
+/// Where the client is reached, the port for tcp and the baud rate for serial.
+pub const Endpoint = union(Transport) {
+    tcp: u16,
+    serial: c_int,
+};
+
+/// The server of the transport chosen at boot, both decode into the net task and have the same interface.
+const Link = union(Transport) {
+    tcp: NetServerT,
+    serial: SerialServerT,
+
+    fn recv(self: *Link) !void {
+        switch (self.*) {
+            inline else => |*server| try server.recv(),
+        }
+    }
+
+    fn send(self: *Link, comptime T: type, message: T) !void {
+        switch (self.*) {
+            inline else => |*server| try server.send(T, message),
+        }
+    }
+
+    /// Until the next step. The serial link wakes up on received bytes, lwIP doesn't offer that to the net task.
+    fn wait(self: *Link, lastWake: *u32) void {
+        switch (self.*) {
+            .tcp => rtos.rtosVTaskDelayUntil(lastWake, 1),
+            .serial => |*server| {
+                server.waitForData(1);
+                lastWake.* = rtos.rtosXTaskGetTickCount();
+            },
+        }
+    }
+
+    fn deinit(self: *Link) void {
+        switch (self.*) {
+            inline else => |*server| server.deinit(),
+        }
+    }
+};
+
+pub const NetStatus = enum(u8) {
+    running,
+    connectionClosed,
+    failed,
+};
+
+/// Runs receiving, decoding, encoding and sending in its own task, so the control loop never waits on the network.
+/// The network is WiFi TCP or the serial link, see Transport.
+/// Decoded commands are queued for the control loop, which applies them at the start of a tick.
+/// setSpeed commands are not queued, only the newest one is applied, so a flood of them can't delay the other commands.
+/// subscribe commands are applied here, the control loop reads the subscriptions of the connection every tick.
+/// A ping is answered here too, so the pong doesn't wait for the control loop.
+/// Messages the control loop sends are queued and encoded and sent here.
+pub const NetTask = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    link: Link,
+    commands: CommandQueue,
+    latestSpeed: LatestSpeed,
+    telemetry: TelemetryQueue,
+    subscriptions: Subscriptions,
+    // Sent after the received bytes are decoded, only the newest ping is answered.
+    pendingPong: ?clientContract.Pong,
+    status: std.atomic.Value(NetStatus),
+
+    /// Blocks until a client is connected. self has to stay at the same address because it is the handler of the decoder.
+    pub fn init(self: *Self, allocator: std.mem.Allocator, endpoint: Endpoint) !void {
+        self.allocator = allocator;
+        self.commands = CommandQueue.init();
+        self.latestSpeed = LatestSpeed.init();
+        self.telemetry = TelemetryQueue.init();
+        self.subscriptions = Subscriptions.init();
+        self.pendingPong = null;
+        self.status = std.atomic.Value(NetStatus).init(.running);
+        self.link = switch (endpoint) {
+            .tcp => |port| .{ .tcp = try NetServerT.init(allocator, port, self) },
+            .serial => |baudRate| .{ .serial = try SerialServerT.init(allocator, baudRate, self) },
+        };
+    }
+
+    pub fn run(arguments: ?*anyopaque) callconv(.c) void {
+        const self: *Self = @ptrCast(@alignCast(arguments.?));
+        var lastWake = rtos.rtosXTaskGetTickCount();
+        while (true) {
+            self.step() catch |err| {
+                const buffer = std.fmt.allocPrintSentinel(self.allocator, "{s}", .{@errorName(err)}, 0) catch @panic("Out of memory");
+                defer self.allocator.free(buffer);
+                utils.espLog(esp.ESP_LOG_ERROR, tag, "Network task stopped with error: %s", buffer.ptr);
+                self.status.store(if (err == error.ConnectionClosed) .connectionClosed else .failed, .release);
+                break;
+            };
+            self.link.wait(&lastWake);
+        }
+        rtos.rtosVTaskDeleteSelf();
+    }
+
+    fn step(self: *Self) !void {
+        try self.link.recv();
+        if (self.pendingPong) |*pong| {
+            pong.deviceSendMicros = utilsZig.timestampMicros();
+            try self.link.send(clientContract.Pong, pong.*);
+            self.pendingPong = null;
+        }
+        while (self.telemetry.pop()) |message| {
+            defer if (message == .log) self.allocator.free(message.log.message);
+            switch (message) {
+                inline else => |value| try self.link.send(@TypeOf(value), value),
+            }
+        }
+    }
+
+    /// Called by the decoder of the net server.
+    pub fn handleCommand(self: *Self, command: serverContract.command) !void {
+        if (command == .setSpeed) {
+            self.latestSpeed.put(command.setSpeed.speed, CommandLatency.nowMicros());
+            return;
+        }
+        if (command == .ping) {
+            self.pendingPong = .{ .clientMicros = command.ping.clientMicros, .deviceReceiveMicros = utilsZig.timestampMicros(), .deviceSendMicros = 0 };
+            return;
+        }
+        if (command == .subscribe) {
+            self.subscriptions.set(command.subscribe);
+            return;
+        }
+        while (!self.commands.push(command)) {
+            rtos.rtosVTaskDelay(1);
+        }
+    }
+
+    pub fn getStatus(self: *Self) NetStatus {
+        return self.status.load(.acquire);
+    }
+
+    pub fn deinit(self: *Self) void {
+        while (self.telemetry.pop()) |message| {
+            if (message == .log) self.allocator.free(message.log.message);
+        }
+        self.link.deinit();
+    }
+};
+
+/// Used by the control loop to send messages to the client through the net task.
+/// Sending never blocks, if the queue is full the message is dropped.
+/// The streams of the subscriptions are decimated with due, which is checked before a message is even built.
+pub const Telemetry = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    queue: *TelemetryQueue,
+    subscriptions: *const Subscriptions,
+    // Per stream in ms * Hz, a sample is due whenever it reaches 1000.
+    phases: [streamCount]u32,
+    droppedCount: u32,
+
+    pub fn init(allocator: std.mem.Allocator, queue: *TelemetryQueue, subscriptions: *const Subscriptions) Self {
+        return .{ .allocator = allocator, .queue = queue, .subscriptions = subscriptions, .phases = @splat(0), .droppedCount = 0 };
+    }
+
+    /// Whether a sample of the stream is due in this tick. Rates which don't divide the rate of the control loop
+    /// are kept on average.
+    pub fn due(self: *Self, stream: Stream, deltaTimeMs: u32) bool {
+        const i = @intFromEnum(stream);
+        const rate: u32 = self.subscriptions.rate(stream);
+        if (rate == 0) {
+            self.phases[i] = 0;
+            return false;
+        }
+        self.phases[i] += deltaTimeMs * rate;
+        if (self.phases[i] < 1000) {
+            return false;
+        }
+        // A rate above the rate of the control loop doesn't carry over.
+        self.phases[i] = (self.phases[i] - 1000) % 1000;
+        return true;
+    }
+
+    /// Messages with a deviceMicros field are stamped with the time they are sent at.
+    pub fn send(self: *Self, comptime T: type, message: T) !void {
+        // The message of a log might live in the arena of the controller which is reset every tick.
+        var owned: T = if (T == clientContract.Log) .{ .level = message.level, .message = try self.allocator.dupe(u8, message.message) } else message;
+        if (@typeInfo(T) == .@"struct" and @hasField(T, "deviceMicros")) {
+            owned.deviceMicros = utilsZig.timestampMicros();
+        }
+        if (!self.queue.push(@unionInit(clientContract.ClientContract, comptime contractFieldName(T), owned))) {
+            if (T == clientContract.Log) self.allocator.free(owned.message);
+            self.droppedCount += 1;
+        }
+    }
+
+    fn contractFieldName(comptime T: type) []const u8 {
+        for (@typeInfo(clientContract.ClientContract).@"union".fields) |field| {
+            if (T == field.type) {
+                return field.name;
+            }
+        }
+        @compileError(@typeName(T) ++ " is not part of the client contract.");
+    }
+};
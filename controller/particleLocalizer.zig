@@ -0,0 +1,65 @@
+const std = @import("std");
+const trackMod = @import("track");
+const Track = trackMod.Track(true);
+const Controller = @import("controller.zig").Controller;
+const ParticleFilter = @import("particleFilter").ParticleFilter;
+const placement = @import("placement");
+const utilsZig = @import("utils.zig");
+
+/// The esp has no FPU, every particle costs a software exp and a normal distributed sample per tick.
+/// How long 128 particles take on the esp hasn't been measured yet, the step times of LoopTiming show it.
+/// The host (positioning test) runs the same filter with many more particles.
+pub const particleCount = 128;
+// Fraction of the heading error which moves the heading offset per update, compensates the drift of the gyro.
+const headingOffsetGain: f32 = 0.01;
+
+/// Runs the particle filter on the measurements of the controller.
+/// The heading of the bmi is integrated from the start, it is turned into the frame of the track
+/// with the heading at the start of the mapping.
+pub const ParticleLocalizer = struct {
+    const Self = @This();
+    const ParticleFilterT = ParticleFilter(particleCount);
+
+    controller: *Controller,
+    filter: *ParticleFilterT,
+    headingOffset: f32,
+    distance: f32,
+    velocity: f32,
+    heading: f32,
+
+    pub fn init(controller: *Controller, track: *Track, headingOffset: f32) !Self {
+        const filter = try controller.allocator.create(ParticleFilterT);
+        const config = controller.config;
+        filter.init(track, @bitCast(utilsZig.timestampMicros()), config.particleVelocityNoiseMPerS, config.particleHeadingNoiseDeg);
+        return .{
+            .controller = controller,
+            .filter = filter,
+            .headingOffset = headingOffset,
+            .distance = 0.0,
+            .velocity = 0.0,
+            .heading = 0.0,
+        };
+    }
+
+    pub fn update(self: *Self) linksection(placement.hotText("particleLocalizer.update")) void {
+        const config = self.controller.config;
+        const dtMs: f32 = @floatFromInt(config.deltaTimeMs);
+        const measuredHeading = @mod(self.controller.bmi.heading - self.headingOffset, 360);
+        self.filter.update(self.controller.tacho.velocity, measuredHeading, dtMs / 1000);
+
+        self.distance = self.filter.distance;
+        self.velocity = self.filter.velocity;
+        self.heading = self.filter.headingAt(self.distance);
+        if (self.filter.distanceVariance < config.maxLocalizationVariance) {
+            self.headingOffset += headingOffsetGain * Track.angularDelta(self.heading, measuredHeading);
+        }
+    }
+
+    pub fn getDistanceVariance(self: *const Self) f32 {
+        return self.filter.distanceVariance;
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.controller.allocator.destroy(self.filter);
+    }
+};
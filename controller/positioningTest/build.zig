@@ -14,7 +14,12 @@ pub fn build(b: *std.Build) void {
     b.installArtifact(exe);
 
     const matrixModule = b.addModule("matrix", .{ .root_source_file = b.path("../../shared/matrix/matrix.zig") });
+    const placementOptions = b.addOptions();
+    placementOptions.addOption(bool, "hotPathsInIram", false);
+    const placementModule = b.addModule("placement", .{ .root_source_file = b.path("../../shared/placement/placement.zig") });
+    placementModule.addOptions("placementOptions", placementOptions);
     const kdTreeModule = b.addModule("kdTree", .{ .root_source_file = b.path("../../shared/kdTree/kdTree.zig") });
+    kdTreeModule.addImport("placement", placementModule);
     exe.root_module.addImport("kdTree", kdTreeModule);
     exe.root_module.addImport("matrix", matrixModule);
     const icpModule = b.addModule("icp", .{ .root_source_file = b.path("../../shared/icp/icp.zig") });
@@ -23,7 +28,36 @@ pub fn build(b: *std.Build) void {
     trackModule.addImport("kdTree", kdTreeModule);
     trackModule.addImport("matrix", matrixModule);
     trackModule.addImport("icp", icpModule);
+    trackModule.addImport("placement", placementModule);
     exe.root_module.addImport("track", trackModule);
+    const particleFilterModule = b.addModule("particleFilter", .{ .root_source_file = b.path("../../shared/particleFilter/particleFilter.zig") });
+    particleFilterModule.addImport("track", trackModule);
+    particleFilterModule.addImport("placement", placementModule);
+    exe.root_module.addImport("particleFilter", particleFilterModule);
+    const configModule = b.addModule("config", .{ .root_source_file = b.path("../../shared/config/config.zig") });
+    const brakeLawModule = b.addModule("brakeLaw", .{ .root_source_file = b.path("../../shared/brakeLaw/brakeLaw.zig") });
+    brakeLawModule.addImport("config", configModule);
+
+    const optimizer = b.addExecutable(.{
+        .name = "lapTimeOptimizer",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/lapTimeOptimizer.zig"),
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    optimizer.root_module.addImport("track", trackModule);
+    optimizer.root_module.addImport("config", configModule);
+    optimizer.root_module.addImport("brakeLaw", brakeLawModule);
+    b.installArtifact(optimizer);
+
+    const optimize_step = b.step("optimize", "Search the self drive config for the minimum lap time on recorded tracks");
+    const optimize_cmd = b.addRunArtifact(optimizer);
+    optimize_step.dependOn(&optimize_cmd.step);
+    optimize_cmd.step.dependOn(b.getInstallStep());
+    if (b.args) |args| {
+        optimize_cmd.addArgs(args);
+    }
 
     const run_step = b.step("run", "Run the app");
     const run_cmd = b.addRunArtifact(exe);
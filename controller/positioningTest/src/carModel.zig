@@ -0,0 +1,57 @@
+const std = @import("std");
+
+/// Simple model of a slot car.
+/// The motor is a first order lag towards a velocity proportional to the duty.
+/// When the lateral acceleration is above the grip of the tires the tail slides out,
+/// the car deslots when the slip angle gets too large.
+pub const CarModel = struct {
+    const Self = @This();
+
+    maxVelocity: f32,
+    motorTimeConstant: f32,
+    gripLateralAcceleration: f32,
+    // Degrees per second of slip per m/s^2 of lateral acceleration above the grip.
+    slipGain: f32,
+    // Fraction of the slip angle recovered per second.
+    slipRecovery: f32,
+    deslotSlipAngle: f32,
+
+    velocity: f32,
+    forwardAcceleration: f32,
+    lateralAcceleration: f32,
+    slipAngle: f32,
+    slipRate: f32,
+
+    pub fn init(maxVelocity: f32, motorTimeConstant: f32, gripLateralAcceleration: f32, slipGain: f32, slipRecovery: f32, deslotSlipAngle: f32) Self {
+        return .{
+            .maxVelocity = maxVelocity,
+            .motorTimeConstant = motorTimeConstant,
+            .gripLateralAcceleration = gripLateralAcceleration,
+            .slipGain = slipGain,
+            .slipRecovery = slipRecovery,
+            .deslotSlipAngle = deslotSlipAngle,
+            .velocity = 0.0,
+            .forwardAcceleration = 0.0,
+            .lateralAcceleration = 0.0,
+            .slipAngle = 0.0,
+            .slipRate = 0.0,
+        };
+    }
+
+    /// dutyFraction is the duty divided by the maximum duty, curvature is in degrees per meter.
+    pub fn update(self: *Self, dutyFraction: f32, curvature: f32, deltaTime: f32) void {
+        const targetVelocity = std.math.clamp(dutyFraction, 0.0, 1.0) * self.maxVelocity;
+        const velocityChange = (targetVelocity - self.velocity) * @min(1.0, deltaTime / self.motorTimeConstant);
+        self.velocity += velocityChange;
+        self.forwardAcceleration = velocityChange / deltaTime;
+
+        self.lateralAcceleration = self.velocity * self.velocity * std.math.degreesToRadians(@abs(curvature));
+        const excess = @max(0.0, self.lateralAcceleration - self.gripLateralAcceleration);
+        self.slipRate = self.slipGain * excess - self.slipRecovery * self.slipAngle;
+        self.slipAngle = @max(0.0, self.slipAngle + self.slipRate * deltaTime);
+    }
+
+    pub fn deslotted(self: Self) bool {
+        return self.slipAngle > self.deslotSlipAngle;
+    }
+};
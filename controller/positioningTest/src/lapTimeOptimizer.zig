@@ -0,0 +1,321 @@
+const std = @import("std");
+
+const Track = @import("track").Track(true);
+const TrackPoint = @import("track").TrackPoint;
+const Config = @import("config").Config;
+const Simulation = @import("simulation.zig").Simulation;
+const CarModel = @import("carModel.zig").CarModel;
+const SelfDrive = @import("selfDrive.zig").SelfDrive;
+
+// The pwm of the controller has a resolution of 10 bit.
+const maxDuty: f32 = 1023.0;
+const deltaTime: f32 = 0.01;
+const maxSimulatedTime: f32 = 300.0;
+
+const Parameter = struct {
+    name: []const u8,
+    min: f32,
+    max: f32,
+};
+
+/// Config fields which are searched, all other fields keep the value of Config.init.
+/// gyroBrakeMultiplier isn't searched, the simulated gyro.y is always 0 (see ImuY).
+const parameters = [_]Parameter{
+    .{ .name = "maxPwm", .min = 200.0, .max = maxDuty },
+    // The brake is in percent, so 10 brakes fully at 10 m/s^2. Config.validate rejects 0.
+    .{ .name = "accelBrakeMultiplier", .min = 0.01, .max = 10.0 },
+    .{ .name = "iirFilterRiseCoefficient", .min = 0.0, .max = 1.0 },
+    .{ .name = "iirFilterFallCoefficient", .min = 0.0, .max = 0.2 },
+};
+
+const Candidate = [parameters.len]f32;
+
+/// Guessed from the size of the car and the track, not fitted to measurements of the car yet,
+/// so the printed config is a starting point for tuning on the track and not a result.
+fn defaultCarModel() CarModel {
+    return CarModel.init(
+        // m/s at full duty
+        3.5,
+        // s until the motor reached 63 % of a velocity step
+        0.25,
+        // m/s^2 the tires hold before the tail slides out
+        6.0,
+        // deg/s of slip per m/s^2 above the grip
+        20.0,
+        // fraction of the slip angle recovered per second
+        2.0,
+        // deg of slip at which the guide leaves the slot
+        30.0,
+    );
+}
+
+/// The horizontal axis of the car the y axis of the bmi points along.
+/// The controller integrates gyro.z as the heading, so z is up, the orientation of x and y isn't recorded anywhere.
+const YAxis = enum {
+    lateral,
+    forward,
+};
+
+/// gyro.y and accel.y which SelfDrive reads from the bmi, in deg/s and m/s^2 like bmi.c converts them.
+const ImuY = struct {
+    gyroY: f32,
+    accelY: f32,
+
+    /// The car model is a rigid car on a flat track, it doesn't rotate about a horizontal axis,
+    /// so gyro.y is 0 for both orientations. The slip only turns the car about z.
+    fn fromCarModel(carModel: *const CarModel, yAxis: YAxis) ImuY {
+        return .{
+            .gyroY = 0.0,
+            .accelY = switch (yAxis) {
+                .lateral => carModel.lateralAcceleration,
+                .forward => carModel.forwardAcceleration,
+            },
+        };
+    }
+};
+
+fn toConfig(candidate: Candidate) Config {
+    var config = Config.init();
+    inline for (parameters, 0..) |parameter, i| {
+        @field(config, parameter.name) = candidate[i];
+    }
+    return config;
+}
+
+/// Drives the laps from standing still and returns the time per lap, null if the car deslotted.
+fn lapTime(track: *Track, config: *const Config, laps: u32, yAxis: YAxis) ?f32 {
+    var prng = std.Random.DefaultPrng.init(0);
+    var rng = prng.random();
+    var simulation = Simulation.init(track, 0.0, 0.0, deltaTime, 0.0, 0.0, 0.0, 0.0, &rng);
+    simulation.setCarModel(defaultCarModel());
+    var selfDrive = SelfDrive.init();
+
+    var completedLaps: u32 = 0;
+    while (simulation.time < maxSimulatedTime) {
+        const imu = ImuY.fromCarModel(&simulation.carModel.?, yAxis);
+        simulation.setDuty(selfDrive.step(config, imu.gyroY, imu.accelY), maxDuty);
+        const prevDistance = simulation.distance;
+        simulation.update();
+        if (simulation.deslotted()) {
+            return null;
+        }
+        if (simulation.distance < prevDistance) {
+            completedLaps += 1;
+            if (completedLaps == laps) {
+                return simulation.time / @as(f32, @floatFromInt(laps));
+            }
+        }
+    }
+    return null;
+}
+
+/// Sum of the lap times over all tracks, infinity if the car deslotted on any of them.
+fn cost(tracks: []Track, candidate: Candidate, laps: u32, yAxis: YAxis) f32 {
+    const config = toConfig(candidate);
+    var sum: f32 = 0.0;
+    for (tracks) |*track| {
+        sum += lapTime(track, &config, laps, yAxis) orelse return std.math.inf(f32);
+    }
+    return sum;
+}
+
+const Evaluation = struct {
+    tracks: []Track,
+    candidates: []const Candidate,
+    costs: []f32,
+    laps: u32,
+    yAxis: YAxis,
+    next: std.atomic.Value(usize),
+
+    fn work(self: *Evaluation) void {
+        while (true) {
+            const i = self.next.fetchAdd(1, .monotonic);
+            if (i >= self.candidates.len) {
+                return;
+            }
+            self.costs[i] = cost(self.tracks, self.candidates[i], self.laps, self.yAxis);
+        }
+    }
+};
+
+/// Evaluates the candidates on all cores.
+fn evaluate(allocator: std.mem.Allocator, tracks: []Track, candidates: []const Candidate, costs: []f32, laps: u32, yAxis: YAxis) !void {
+    var evaluation: Evaluation = .{
+        .tracks = tracks,
+        .candidates = candidates,
+        .costs = costs,
+        .laps = laps,
+        .yAxis = yAxis,
+        .next = std.atomic.Value(usize).init(0),
+    };
+    const threadCount = std.Thread.getCpuCount() catch 1;
+    const threads = try allocator.alloc(std.Thread, threadCount);
+    defer allocator.free(threads);
+    for (threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, Evaluation.work, .{&evaluation});
+    }
+    for (threads) |thread| {
+        thread.join();
+    }
+}
+
+fn randomCandidate(rng: std.Random) Candidate {
+    var candidate: Candidate = undefined;
+    for (parameters, 0..) |parameter, i| {
+        candidate[i] = parameter.min + rng.float(f32) * (parameter.max - parameter.min);
+    }
+    return candidate;
+}
+
+/// Normal distributed around the center with the standard deviation as a fraction of the range of each parameter.
+fn neighborCandidate(rng: std.Random, center: Candidate, standardDeviation: f32) Candidate {
+    var candidate: Candidate = undefined;
+    for (parameters, 0..) |parameter, i| {
+        const range = parameter.max - parameter.min;
+        candidate[i] = std.math.clamp(center[i] + rng.floatNorm(f32) * standardDeviation * range, parameter.min, parameter.max);
+    }
+    return candidate;
+}
+
+fn loadTrack(allocator: std.mem.Allocator, path: []const u8) !Track {
+    const content = try std.fs.cwd().readFileAlloc(allocator, path, 16 * 1024 * 1024);
+    defer allocator.free(content);
+
+    var trackPoints = try std.ArrayList(TrackPoint).initCapacity(allocator, 100);
+    errdefer trackPoints.deinit(allocator);
+    var lines = std.mem.tokenizeAny(u8, content, "\r\n");
+    // header of track.csv written by the client
+    _ = lines.next();
+    while (lines.next()) |line| {
+        var values = std.mem.splitScalar(u8, line, ',');
+        const distance = try std.fmt.parseFloat(f32, values.next() orelse return error.InvalidTrackFile);
+        const heading = try std.fmt.parseFloat(f32, values.next() orelse return error.InvalidTrackFile);
+        try trackPoints.append(allocator, .{ .distance = distance, .heading = heading });
+    }
+    return try Track.init(allocator, try trackPoints.toOwnedSlice(allocator));
+}
+
+const usage =
+    \\Usage: lapTimeOptimizer [--samples <count>] [--rounds <count>] [--laps <count>] [--seed <seed>] [--yAxis lateral|forward] <track.csv>...
+    \\
+    \\Searches the SelfDrive parameters of the config for the minimum lap time without deslotting
+    \\on the tracks recorded by the client (track.csv) and prints them as config commands.
+    \\--yAxis is the axis of the car the y axis of the bmi points along (default: lateral).
+    \\
+;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+
+    var samples: usize = 2000;
+    var rounds: usize = 10;
+    var laps: u32 = 3;
+    var seed: u64 = 0;
+    var yAxis: YAxis = .lateral;
+    var tracks = try std.ArrayList(Track).initCapacity(allocator, 1);
+    defer {
+        for (tracks.items) |*track| {
+            track.deinit();
+        }
+        tracks.deinit(allocator);
+    }
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        const isOption = std.mem.startsWith(u8, arg, "--");
+        if (isOption and i + 1 >= args.len) {
+            std.debug.print(usage, .{});
+            return error.OptionWithoutValue;
+        }
+        if (std.mem.eql(u8, arg, "--samples")) {
+            i += 1;
+            samples = try std.fmt.parseInt(usize, args[i], 10);
+        } else if (std.mem.eql(u8, arg, "--rounds")) {
+            i += 1;
+            rounds = try std.fmt.parseInt(usize, args[i], 10);
+        } else if (std.mem.eql(u8, arg, "--laps")) {
+            i += 1;
+            laps = try std.fmt.parseInt(u32, args[i], 10);
+        } else if (std.mem.eql(u8, arg, "--seed")) {
+            i += 1;
+            seed = try std.fmt.parseInt(u64, args[i], 10);
+        } else if (std.mem.eql(u8, arg, "--yAxis")) {
+            i += 1;
+            yAxis = std.meta.stringToEnum(YAxis, args[i]) orelse {
+                std.debug.print(usage, .{});
+                return error.UnknownAxis;
+            };
+        } else if (isOption) {
+            std.debug.print(usage, .{});
+            return error.UnknownOption;
+        } else {
+            try tracks.append(allocator, try loadTrack(allocator, arg));
+        }
+    }
+    if (tracks.items.len == 0 or samples == 0 or laps == 0) {
+        std.debug.print(usage, .{});
+        return error.MissingTrack;
+    }
+
+    var prng = std.Random.DefaultPrng.init(seed);
+    const rng = prng.random();
+    const candidates = try allocator.alloc(Candidate, samples);
+    defer allocator.free(candidates);
+    const costs = try allocator.alloc(f32, samples);
+    defer allocator.free(costs);
+
+    // Random search over the whole range first, then shrinking random searches around the best candidate.
+    var best: Candidate = toCandidate(Config.init());
+    var bestCost = cost(tracks.items, best, laps, yAxis);
+    var standardDeviation: f32 = 0.2;
+    for (0..rounds + 1) |round| {
+        for (candidates) |*candidate| {
+            candidate.* = if (round == 0) randomCandidate(rng) else neighborCandidate(rng, best, standardDeviation);
+        }
+        try evaluate(allocator, tracks.items, candidates, costs, laps, yAxis);
+        for (candidates, costs) |candidate, candidateCost| {
+            if (candidateCost < bestCost) {
+                best = candidate;
+                bestCost = candidateCost;
+            }
+        }
+        if (round != 0) {
+            standardDeviation *= 0.7;
+        }
+        std.debug.print("round {d}: mean lap time {d:.3} s\n", .{ round, bestCost / @as(f32, @floatFromInt(tracks.items.len)) });
+    }
+
+    if (std.math.isInf(bestCost)) {
+        std.debug.print("No parameters found which don't deslot.\n", .{});
+        return;
+    }
+
+    // On stderr, so the config commands on stdout can still be pasted as they are.
+    std.debug.print(
+        "Assumed the y axis of the bmi along the {s} axis of the car, gyroBrakeMultiplier keeps its value.\n" ++
+            "The car model isn't fitted to the car, tune the config on the track from here.\n",
+        .{@tagName(yAxis)},
+    );
+    var buffer: [4096]u8 = undefined;
+    var stdoutWriter = std.fs.File.stdout().writer(&buffer);
+    const stdout = &stdoutWriter.interface;
+    inline for (parameters, 0..) |parameter, j| {
+        const upperFirst: [1]u8 = comptime .{std.ascii.toUpper(parameter.name[0])};
+        try stdout.print("config set{s}{s} --{s} {d}\n", .{ upperFirst, parameter.name[1..], parameter.name, best[j] });
+    }
+    try stdout.flush();
+}
+
+fn toCandidate(config: Config) Candidate {
+    var candidate: Candidate = undefined;
+    inline for (parameters, 0..) |parameter, i| {
+        candidate[i] = @field(config, parameter.name);
+    }
+    return candidate;
+}
@@ -2,14 +2,19 @@ const std = @import("std");
 
 const Track = @import("track").Track(true);
 const TrackPoint = @import("track").TrackPoint;
+const sineTrack = @import("track").sineTrack;
 const Position = @import("track").Position;
 const Simulation = @import("simulation.zig").Simulation;
 const Controller = @import("controller.zig").Controller;
+const ParticleFilter = @import("particleFilter").ParticleFilter;
 
 const guiApi = @import("gui.zig");
 const Gui = guiApi.Gui;
 const rl = @import("raylib");
 
+// The esp runs 128 particles, on the host the filter can be compared with many more.
+const hostParticleCount = 8192;
+
 const DistancePosition = struct {
     distance: f32,
     position: rl.Vector2
@@ -19,19 +24,7 @@ pub fn main() !void {
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     const allocator = gpa.allocator();
 
-    const pointCount: usize = 721;
-    const density: f32 = 1.0;
-    const densityUsize: usize = @intFromFloat(density);
-    var trackPointsArrayList = try std.ArrayList(TrackPoint).initCapacity(allocator, pointCount * densityUsize + 1);
-    for (0..pointCount * densityUsize + 1) |i| {
-        const iF32: f32 = @floatFromInt(i);
-        try trackPointsArrayList.append(allocator, .{
-            .distance = iF32 * 0.01 / density,
-            .heading = @mod(std.math.sin(iF32 / density / 360 * 2 * std.math.pi) * 150 + 360, 360),
-        });
-    }
-    const trackPoints = try trackPointsArrayList.toOwnedSlice(allocator);
-    var track = try Track.init(allocator, trackPoints);
+    var track = try sineTrack.init(true, allocator, 721);
     defer track.deinit();
 
     
@@ -64,6 +57,13 @@ pub fn main() !void {
 
     var headingError: f32 = 0.0;
 
+    const particleFilter = try allocator.create(ParticleFilter(hostParticleCount));
+    defer allocator.destroy(particleFilter);
+    particleFilter.init(&track, rng.int(u64), 0.05, 5.0);
+    // Integrated from the measured angular rate like the heading of the bmi.
+    var measuredHeading: f32 = simulation.heading;
+    var step: usize = 0;
+
     while (true) {
         gui.update() catch |err| switch (err) {
             guiApi.GuiError.Quit => return,
@@ -76,6 +76,16 @@ pub fn main() !void {
         const prevHeading = simulation.heading;
         simulation.update();
         controller.update();
+        measuredHeading = @mod(measuredHeading + simulation.measuredAngularRate * simulation.deltaTime, 360);
+        particleFilter.update(simulation.measuredVelocity, measuredHeading, simulation.deltaTime);
+        step += 1;
+        if (step % 100 == 0) {
+            std.debug.print("distance error: kalman filter {d:.4}, particle filter {d:.4} (variance {d:.5})\n", .{
+                track.distanceDelta(simulation.distance, controller.distance),
+                track.distanceDelta(simulation.distance, particleFilter.distance),
+                particleFilter.distanceVariance,
+            });
+        }
 
         //const decay = 1 - (factor1 * velocity / (10 * maxVelocity) + factor2 * pwm / (10 * maxPwm)) + factor3
         const decay = 0.95;
@@ -0,0 +1,22 @@
+const Config = @import("config").Config;
+const brakeLaw = @import("brakeLaw");
+
+/// SelfDrive (controller/controllerStates/selfDrive.zig) without the hardware, both step with brakeLaw.
+pub const SelfDrive = struct {
+    const Self = @This();
+
+    prevBrake: f32,
+
+    pub fn init() Self {
+        return .{
+            .prevBrake = 1.0,
+        };
+    }
+
+    /// Returns the duty.
+    pub fn step(self: *Self, conf: *const Config, gyroY: f32, accelY: f32) f32 {
+        const brakeStep = brakeLaw.step(conf, self.prevBrake, gyroY, accelY);
+        self.prevBrake = brakeStep.brake;
+        return brakeStep.duty;
+    }
+};
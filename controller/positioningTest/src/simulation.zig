@@ -2,6 +2,7 @@ const std = @import("std");
 const t = @import("track");
 const Track = t.Track(true);
 const TrackPoint = t.TrackPoint;
+const CarModel = @import("carModel.zig").CarModel;
 
 pub const Simulation = struct {
     const Self = @This();
@@ -20,6 +21,9 @@ pub const Simulation = struct {
     deltaTime: f32,
     time: f32,
     rng: *std.Random,
+    // Without a car model the velocity stays constant.
+    carModel: ?CarModel,
+    dutyFraction: f32,
 
     pub fn init(track: *Track, initialDistance: f32, velocity: f32, deltaTime: f32, angularRateNoise: f32, angularRateBias: f32, velocityNoise: f32, velocityBias: f32, rng: *std.Random) Self {
         return .{
@@ -37,11 +41,31 @@ pub const Simulation = struct {
             .angularRateNoise = angularRateNoise,
             .angularRateBias = angularRateBias,
             .rng = rng,
+            .carModel = null,
+            .dutyFraction = 0.0,
         };
     }
 
+    /// The velocity then follows the duty set with setDuty.
+    pub fn setCarModel(self: *Self, carModel: CarModel) void {
+        self.carModel = carModel;
+        self.carModel.?.velocity = self.velocity;
+    }
+
+    pub fn setDuty(self: *Self, duty: f32, maxDuty: f32) void {
+        self.dutyFraction = duty / maxDuty;
+    }
+
+    pub fn deslotted(self: Self) bool {
+        return if (self.carModel) |carModel| carModel.deslotted() else false;
+    }
+
     pub fn update(self: *Self) void {
         self.time += self.deltaTime;
+        if (self.carModel) |*carModel| {
+            carModel.update(self.dutyFraction, self.track.distanceToHeadingDerivative(self.distance), self.deltaTime);
+            self.velocity = carModel.velocity;
+        }
         self.distance = @mod(self.distance + self.velocity * self.deltaTime, self.track.getTrackLength());
         const newHeading = self.track.distanceToHeading(self.distance);
         self.angularRate = Track.angularDelta(self.heading, newHeading) / self.deltaTime;
@@ -0,0 +1,74 @@
+const std = @import("std");
+
+const serial = @cImport(@cInclude("serial.h"));
+const utils = @cImport(@cInclude("utils.h"));
+
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const decode = @import("decode");
+const encode = @import("encode");
+
+const tag = "serial server";
+
+/// The same contracts and message format as NetServer over UART1, see serial.c.
+/// A serial line has no connection, the client is connected once it sent something, and it can be opened
+/// in the middle of a message, so malformed messages are skipped instead of failing.
+/// receiveBufferSize is the most that is read at once, recv reads until the receive buffer of the driver is empty.
+pub fn SerialServer(comptime serverContractEnumT: type, comptime serverContractT: type, comptime handlerT: type, comptime clientContractT: type, comptime receiveBufferSize: usize) type {
+    return struct {
+        allocator: std.mem.Allocator,
+        decoder: decode.Decoder(serverContractEnumT, serverContractT, handlerT),
+
+        const Encoder = encode.Encoder(clientContractT);
+
+        const Self = @This();
+        var buffer: [receiveBufferSize]u8 = undefined;
+
+        /// Blocks until the client sent its first bytes.
+        pub fn init(allocator: std.mem.Allocator, baudRate: c_int, handler: *handlerT) !Self {
+            serial.serialInit(baudRate);
+            while (serial.serialWaitForData(100) != serial.SERIAL_DATA) {}
+
+            const decoder = decode.Decoder(serverContractEnumT, serverContractT, handlerT).init(allocator, handler);
+            return .{ .allocator = allocator, .decoder = decoder };
+        }
+
+        /// Returns when bytes were received or after ticks, so the net task reacts to a command right away.
+        /// The driver dropped its received bytes after an overflow, the message the decoder collected so far
+        /// would be completed with bytes of another one, so it skips to the next message.
+        pub fn waitForData(self: *Self, ticks: u32) void {
+            if (serial.serialWaitForData(ticks) == serial.SERIAL_OVERFLOW) {
+                self.decoder.resynchronize();
+            }
+        }
+
+        pub fn recv(self: *Self) !void {
+            while (true) {
+                const bytesRead = serial.serialRead(&buffer, buffer.len);
+                if (bytesRead == 0) {
+                    return;
+                }
+                if (bytesRead < 0) {
+                    return error.RecvFailed;
+                }
+                const errorCount = try self.decoder.decodeSkippingErrors(buffer[0..@intCast(bytesRead)]);
+                if (errorCount > 0) {
+                    utils.espLog(esp.ESP_LOG_WARN, tag, "Skipped %d malformed messages", @as(c_int, @intCast(errorCount)));
+                }
+            }
+        }
+
+        pub fn send(_: *Self, comptime T: type, message: T) !void {
+            const bytes = try Encoder.encode(T, message);
+            if (serial.serialWrite(bytes.ptr, bytes.len) != serial.SERIAL_OK) {
+                return error.SendFailed;
+            }
+        }
+
+        pub fn deinit(_: Self) void {
+            serial.serialDeinit();
+        }
+    };
+}
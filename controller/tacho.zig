@@ -1,30 +1,83 @@
+const std = @import("std");
 const utilsZig = @import("utils.zig");
 const pt = @cImport(@cInclude("pt.h"));
+const pcnt = @cImport(@cInclude("pcnt.h"));
+const utils = @cImport(@cInclude("utils.h"));
 const Config = @import("config").Config;
+const SpscQueue = @import("spscQueue").SpscQueue;
+const tachoOptions = @import("tachoOptions");
+const rtos = @cImport(@cInclude("rtos.h"));
 const c = @cImport({
     @cInclude("stdio.h");
 });
+const esp = @cImport({
+    @cInclude("esp_log.h");
+});
+
+const tag = "tacho";
+
+pub const Backend = enum {
+    // An interrupt for every pulse captures the period with a timer.
+    timer,
+    // The pulse counter hardware counts the pulses, an interrupt only every watch step captures the period.
+    pulseCounter,
+};
+
+/// The pulse counter where the chip has one, the ESP32-C3 has none.
+pub const backend: Backend = if (pcnt.PCNT_SUPPORTED != 0) .pulseCounter else .timer;
+
+/// Built with -DtachoStatistics, see Statistics.
+pub const statisticsEnabled = tachoOptions.tachoStatistics;
 
 pub const Tacho = struct {
     const Self = @This();
+    const gpio = 6;
+    // With the pulse counter the period is measured over this many pulses.
+    const watchStep = 5;
+    const statisticsInterval: u32 = 1000;
 
     pulsesPerRotation: *f32,
     tireCircumferenceMm: *f32,
     measurementTime: i64,
+    prevPulseCount: c_int,
     velocity: f32,
     distance: f32,
+    statistics: if (statisticsEnabled) Statistics else void,
 
+    pub fn initHardware() void {
+        switch (backend) {
+            .timer => pt.ptInit(),
+            .pulseCounter => {
+                pcnt.pcntInit(gpio, watchStep);
+                pcnt.pcntStart();
+            },
+        }
+    }
+
+    /// The hardware of the backend has to be initialized before with initHardware.
     pub fn init(config: *Config) Self {
         return .{
             .pulsesPerRotation = &config.pulsesPerRotation,
             .tireCircumferenceMm = &config.tireCircumferenceMm,
             .measurementTime = utilsZig.timestampMicros(),
+            .prevPulseCount = 0,
             .velocity = 0.0,
             .distance = 0.0,
+            .statistics = if (statisticsEnabled) Statistics.init() else {},
         };
     }
 
     pub fn update(self: *Self) !void {
+        switch (backend) {
+            .timer => self.updateTimer(),
+            .pulseCounter => self.updatePulseCounter(),
+        }
+        if (statisticsEnabled) {
+            self.statistics.add(self.velocity);
+        }
+    }
+
+    fn updateTimer(self: *Self) void {
         const timeDiffMicros: f32 = @floatFromInt(utilsZig.timestampMicros() - self.measurementTime);
         if (!pt.ptUpdatedPeriod()) {
             self.velocity = @min(self.velocity, self.tireCircumferenceMm.* / 1_000.0 / timeDiffMicros / 1_000_000.0);
@@ -42,7 +95,102 @@ pub const Tacho = struct {
         self.distance += self.velocity * timeDiffMicros / 1_000_000.0;
     }
 
+    fn updatePulseCounter(self: *Self) void {
+        const metersPerPulse = self.tireCircumferenceMm.* / 1_000.0 / self.pulsesPerRotation.*;
+
+        // The distance comes straight from the count, so no pulse is lost by integrating the velocity.
+        const pulseCount = pcnt.pcntGetCount();
+        const pulses: f32 = @floatFromInt(pulseCount -% self.prevPulseCount);
+        self.prevPulseCount = pulseCount;
+        self.distance += pulses * metersPerPulse;
+
+        var period: pcnt.PcntPeriod = .{ .pulses = 0, .seconds = 0.0 };
+        if (pcnt.pcntGetPeriod(&period) and period.seconds > 0.0) {
+            const periodPulses: f32 = @floatFromInt(period.pulses);
+            self.velocity = periodPulses * metersPerPulse / period.seconds;
+            return;
+        }
+
+        // Without a new period the car can at most be as fast as if the next event happened right now.
+        const secondsSinceLastEvent: f32 = @as(f32, @floatFromInt(pcnt.pcntMicrosSinceLastEvent())) / 1_000_000.0;
+        if (period.pulses == 0 and secondsSinceLastEvent > 0.0) {
+            self.velocity = @min(self.velocity, watchStep * metersPerPulse / secondsSinceLastEvent);
+        }
+    }
+
     pub fn reset(self: *Self) void {
         self.distance = 0.0;
     }
 };
+
+const Summary = struct {
+    micros: i64,
+    interrupts: u32,
+    count: u32,
+    mean: f32,
+    m2: f32,
+};
+
+var summaries = SpscQueue(Summary, 4).init();
+
+/// Collects the interrupts of the backend and the noise of the velocity, to compare the backends at a constant wheel speed.
+/// The control task only accumulates in f32, the esp has no FPU, the summaries are logged by runStatisticsTask,
+/// so neither the division nor the log run in the control loop.
+const Statistics = struct {
+    const Self = @This();
+
+    startTime: i64,
+    startInterruptCount: u32,
+    count: u32,
+    mean: f32,
+    m2: f32,
+
+    fn init() Self {
+        return .{
+            .startTime = utilsZig.timestampMicros(),
+            .startInterruptCount = interruptCount(),
+            .count = 0,
+            .mean = 0.0,
+            .m2 = 0.0,
+        };
+    }
+
+    fn interruptCount() u32 {
+        return switch (backend) {
+            .timer => pt.ptGetInterruptCount(),
+            .pulseCounter => pcnt.pcntGetInterruptCount(),
+        };
+    }
+
+    fn add(self: *Self, velocity: f32) void {
+        self.count += 1;
+        const delta = velocity - self.mean;
+        self.mean += delta / @as(f32, @floatFromInt(self.count));
+        self.m2 += delta * (velocity - self.mean);
+
+        if (self.count < Tacho.statisticsInterval) {
+            return;
+        }
+        // Dropped if the statistics task is behind.
+        _ = summaries.push(.{
+            .micros = utilsZig.timestampMicros() - self.startTime,
+            .interrupts = interruptCount() -% self.startInterruptCount,
+            .count = self.count,
+            .mean = self.mean,
+            .m2 = self.m2,
+        });
+        self.* = init();
+    }
+};
+
+/// Logs the summaries of the statistics, runs with a low priority.
+pub fn runStatisticsTask(_: ?*anyopaque) callconv(.c) void {
+    while (true) : (rtos.rtosVTaskDelay(rtos.rtosMillisToTicks(1000))) {
+        while (summaries.pop()) |summary| {
+            const seconds: f32 = @as(f32, @floatFromInt(summary.micros)) / 1_000_000.0;
+            const interrupts: f32 = @floatFromInt(summary.interrupts);
+            const standardDeviation = @sqrt(summary.m2 / @as(f32, @floatFromInt(summary.count - 1)));
+            utils.espLog(esp.ESP_LOG_INFO, tag, "%s: %.0f interrupts/s, velocity mean %.3f m/s, standard deviation %.4f m/s", @tagName(backend).ptr, interrupts / seconds, summary.mean, standardDeviation);
+        }
+    }
+}
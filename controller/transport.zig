@@ -0,0 +1,55 @@
+const std = @import("std");
+
+const utils = @cImport(@cInclude("utils.h"));
+
+const esp = @cImport({
+    @cInclude("nvs.h");
+    @cInclude("esp_log.h");
+});
+
+const tag = "transport";
+const namespace = "storage";
+const transportKey = "transport";
+
+/// How the contracts are sent between the controller and the client, chosen at boot.
+/// serial is a wired link over UART1, WiFi isn't started then.
+pub const Transport = enum(u8) {
+    tcp,
+    serial,
+};
+
+/// Falls back to tcp if nothing or something unknown is stored.
+pub fn load() Transport {
+    var nvsHandle: esp.nvs_handle_t = undefined;
+    if (esp.nvs_open(namespace, esp.NVS_READONLY, &nvsHandle) != esp.ESP_OK) {
+        return .tcp;
+    }
+    defer esp.nvs_close(nvsHandle);
+
+    var stored: u8 = 0;
+    if (esp.nvs_get_u8(nvsHandle, transportKey, &stored) != esp.ESP_OK) {
+        return .tcp;
+    }
+    return std.meta.intToEnum(Transport, stored) catch .tcp;
+}
+
+pub fn store(transport: Transport) !void {
+    var nvsHandle: esp.nvs_handle_t = undefined;
+    var err = esp.nvs_open(namespace, esp.NVS_READWRITE, &nvsHandle);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error opening flash memory handle: %s", esp.esp_err_to_name(err));
+        return error.NvsOpenFailed;
+    }
+    defer esp.nvs_close(nvsHandle);
+
+    err = esp.nvs_set_u8(nvsHandle, transportKey, @intFromEnum(transport));
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error writing transport: %s", esp.esp_err_to_name(err));
+        return error.NvsWriteFailed;
+    }
+    err = esp.nvs_commit(nvsHandle);
+    if (err != esp.ESP_OK) {
+        utils.espLog(esp.ESP_LOG_ERROR, tag, "Error commiting transport to flash memory: %s", esp.esp_err_to_name(err));
+        return error.NvsWriteFailed;
+    }
+}
@@ -17,6 +17,8 @@ const utils = @cImport(@cInclude("utils.h"));
 
 const commandParserMod = @import("commandParser");
 const CommandParser = commandParserMod.CommandParser;
+const geometryBenchmark = @import("geometryBenchmark.zig");
+const transportMod = @import("transport.zig");
 
 const tag = "uart console";
 const backspace = 8;
@@ -24,14 +26,25 @@ const backspace = 8;
 const CommandsEnum = enum {
     set,
     restart,
+    benchmark,
+    transport,
 };
 
 const commands = union(CommandsEnum) {
     set: set,
     restart: restart,
+    benchmark: benchmark,
+    transport: transport,
 };
 
 const restart = struct {};
+// Compares the kd tree and icp with f32 and f64 track points.
+const benchmark = struct {};
+
+// Selects tcp or serial for the contracts, it is used after the next restart.
+const transport = struct {
+    link: []const u8,
+};
 
 const set = struct {
     ssid: []const u8,
@@ -74,6 +87,7 @@ pub const UartConsole = struct {
         const descriptions: []const commandParserMod.FieldDescription = &.{
             .{ .fieldName = "ssid", .description = "The name of the wlan to connect to." },
             .{ .fieldName = "password", .description = "The passowrd for the wlan to connect to." },
+            .{ .fieldName = "link", .description = "tcp over the wlan or serial over UART1." },
         };
 
         var nvsHandle: esp.nvs_handle_t = undefined;
@@ -134,6 +148,17 @@ pub const UartConsole = struct {
                 CommandsEnum.restart => |_| {
                     esp.esp_restart();
                 },
+                CommandsEnum.transport => |transportCmd| {
+                    const selected = std.meta.stringToEnum(transportMod.Transport, transportCmd.link) orelse {
+                        _ = c.printf("The link has to be tcp or serial\n");
+                        continue;
+                    };
+                    transportMod.store(selected) catch continue;
+                    _ = c.printf("Set the transport to %s, restart to use it\n", @tagName(selected).ptr);
+                },
+                CommandsEnum.benchmark => |_| {
+                    geometryBenchmark.start();
+                },
             }
         }
     }
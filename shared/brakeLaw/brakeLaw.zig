@@ -0,0 +1,36 @@
+const std = @import("std");
+const Config = @import("config").Config;
+
+pub const BrakeStep = struct {
+    // Filtered brake in percent, the prevBrake of the next step.
+    brake: f32,
+    duty: f32,
+};
+
+/// The brake law of the self drive state, also used by the lap time optimizer to simulate it.
+/// The brake grows with the yaw rate and the lateral acceleration, is filtered with a faster rise than fall
+/// and capped at 100 percent, where the duty reaches 0.
+/// Inline, so it stays in the hot text of the caller.
+pub inline fn step(conf: *const Config, prevBrake: f32, gyroY: f32, accelY: f32) BrakeStep {
+    const brake = @abs(gyroY) * conf.gyroBrakeMultiplier + @abs(accelY) * conf.accelBrakeMultiplier;
+    const iirFilterCoefficient = if (brake > prevBrake) conf.iirFilterRiseCoefficient else conf.iirFilterFallCoefficient;
+    const filteredBrakeUncapped = (1 - iirFilterCoefficient) * prevBrake + iirFilterCoefficient * brake;
+    const filteredBrake = if (filteredBrakeUncapped > 100.0) 100.0 else filteredBrakeUncapped;
+    const factor = 1 - (filteredBrake / 100.0);
+    return .{ .brake = filteredBrake, .duty = conf.maxPwm * factor };
+}
+
+test "brakeRisesFasterThanItFalls" {
+    const conf = Config.init();
+    var brake: f32 = 0.0;
+    for (0..10) |_| {
+        brake = step(&conf, brake, 1000.0, 0.0).brake;
+    }
+    try std.testing.expectEqual(100.0, brake);
+    try std.testing.expectEqual(0.0, step(&conf, brake, 1000.0, 0.0).duty);
+
+    const released = step(&conf, brake, 0.0, 0.0);
+    try std.testing.expect(released.brake < brake);
+    try std.testing.expect(brake - released.brake < 100.0 * conf.iirFilterRiseCoefficient);
+    try std.testing.expectApproxEqAbs(conf.maxPwm * (1 - released.brake / 100.0), released.duty, 1e-3);
+}
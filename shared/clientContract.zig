@@ -1,6 +1,11 @@
 pub const TrackPoint = @import("track").TrackPoint;
+pub const ConfigSnapshot = @import("config").Config;
+
+// deviceMicros of the telemetry messages is the time of the controller in microseconds since boot when it was sent.
+// It is filled in by the controller, with the clock offset from ping and pong the client knows how old a message is.
 
 pub const Measurement = struct {
+    deviceMicros: i64 = 0,
     time: f32,
     heading: f32,
     accelerationX: f32,
@@ -10,6 +15,21 @@ pub const Measurement = struct {
     velocity: f32,
 };
 
+// The heading and the acceleration as streams of their own, so the client can subscribe to them at different rates.
+pub const HeadingSample = struct {
+    deviceMicros: i64 = 0,
+    time: f32,
+    heading: f32,
+};
+
+pub const AccelerationSample = struct {
+    deviceMicros: i64 = 0,
+    time: f32,
+    accelerationX: f32,
+    accelerationY: f32,
+    accelerationZ: f32,
+};
+
 pub const LogLevel = enum(u8) {
     debug,
     info,
@@ -37,8 +57,18 @@ pub const resetMapping = struct {};
 pub const endMapping = struct {};
 
 pub const CarTrackPoint = struct {
-    distance: f32,   
+    deviceMicros: i64 = 0,
+    distance: f32,
     heading: f32,
+    // So the client can extrapolate the car to the time it is drawn.
+    velocity: f32,
+};
+
+// The answer to a ping, clientMicros is copied from the ping.
+pub const Pong = struct {
+    clientMicros: i64,
+    deviceReceiveMicros: i64,
+    deviceSendMicros: i64,
 };
 
 pub const ClientContractEnum = enum(u8) {
@@ -47,6 +77,10 @@ pub const ClientContractEnum = enum(u8) {
     carTrackPoint,
     log,
     command,
+    configSnapshot,
+    headingSample,
+    accelerationSample,
+    pong,
 };
 
 pub const ClientContract = union(ClientContractEnum) {
@@ -55,4 +89,8 @@ pub const ClientContract = union(ClientContractEnum) {
     carTrackPoint: CarTrackPoint,
     log: Log,
     command: command,
+    configSnapshot: ConfigSnapshot,
+    headingSample: HeadingSample,
+    accelerationSample: AccelerationSample,
+    pong: Pong,
 };
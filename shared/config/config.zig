@@ -16,6 +16,24 @@ pub const Config = struct {
     minTrackPointDistanceMm: f32,
     deltaTimeMs: u32,
     dutyMapTrack: u32,
+    // Velocity at maxPwm, used as the feed forward of the adaptive self drive.
+    maxVelocityMPerS: f32,
+    maxLateralAccelerationMPerS2: f32,
+    velocityGain: f32,
+    // The curvature is read this far ahead of the car, plus the distance driven in lookaheadTimeS.
+    lookaheadMinM: f32,
+    lookaheadTimeS: f32,
+    // Variance of the distance of the localizer below which the map is trusted.
+    maxLocalizationVariance: f32,
+    // 0: kalman filter, 1: particle filter. Read when the mapping ends.
+    localizer: u32,
+    particleVelocityNoiseMPerS: f32,
+    particleHeadingNoiseDeg: f32,
+    // The kalman filter relocalizes with the heading signature of the track when the distance innovation
+    // stays above relocalizationInnovationM for relocalizationTicks ticks, if the best match is confident enough.
+    relocalizationInnovationM: f32,
+    relocalizationTicks: u32,
+    minRelocalizationConfidence: f32,
 
 
     pub fn init() Self {
@@ -32,9 +50,84 @@ pub const Config = struct {
             .minTrackPointDistanceMm = 1.0,
             .deltaTimeMs = 10,
             .dutyMapTrack = 500,
+            .maxVelocityMPerS = 3.0,
+            .maxLateralAccelerationMPerS2 = 6.0,
+            .velocityGain = 1.0,
+            .lookaheadMinM = 0.1,
+            .lookaheadTimeS = 0.3,
+            .maxLocalizationVariance = 0.05,
+            .localizer = 0,
+            .particleVelocityNoiseMPerS = 0.1,
+            .particleHeadingNoiseDeg = 10.0,
+            .relocalizationInnovationM = 0.3,
+            .relocalizationTicks = 50,
+            .minRelocalizationConfidence = 0.8,
         };
     }
+
+    pub const ValidationError = error{
+        DeltaTimeBelowTick,
+        UnknownLocalizer,
+        NotFinite,
+        NotPositive,
+    };
+
+    /// Rejects configs the controller can't run with, tickPeriodMs is the period of the FreeRTOS tick.
+    /// The control loop delays by deltaTimeMs in whole ticks, so it may not be shorter than one.
+    pub fn validate(self: *const Self, tickPeriodMs: u32) ValidationError!void {
+        if (self.deltaTimeMs < tickPeriodMs) {
+            return error.DeltaTimeBelowTick;
+        }
+        if (self.localizer > 1) {
+            return error.UnknownLocalizer;
+        }
+        inline for (@typeInfo(Self).@"struct".fields) |field| {
+            if (field.type == f32) {
+                if (!std.math.isFinite(@field(self, field.name))) {
+                    return error.NotFinite;
+                }
+            }
+        }
+        // Gains, noises and the values the controller divides by.
+        const positive = [_]f32{
+            self.gyroBrakeMultiplier,
+            self.accelBrakeMultiplier,
+            self.velocityGain,
+            self.particleVelocityNoiseMPerS,
+            self.particleHeadingNoiseDeg,
+            self.pulsesPerRotation,
+            self.tireCircumferenceMm,
+            self.maxVelocityMPerS,
+        };
+        for (positive) |value| {
+            if (value <= 0.0) {
+                return error.NotPositive;
+            }
+        }
+    }
 };
+
+test "defaultConfigIsValid" {
+    try Config.init().validate(10);
+}
+
+test "invalidConfigsAreRejected" {
+    var config = Config.init();
+    config.deltaTimeMs = 5;
+    try std.testing.expectError(error.DeltaTimeBelowTick, config.validate(10));
+
+    config = Config.init();
+    config.localizer = 2;
+    try std.testing.expectError(error.UnknownLocalizer, config.validate(10));
+
+    config = Config.init();
+    config.lookaheadTimeS = std.math.nan(f32);
+    try std.testing.expectError(error.NotFinite, config.validate(10));
+
+    config = Config.init();
+    config.particleHeadingNoiseDeg = 0.0;
+    try std.testing.expectError(error.NotPositive, config.validate(10));
+}
     
 pub fn configCommand() type {
     const typeInfo = @typeInfo(Config).@"struct";
@@ -1,20 +1,40 @@
 const std = @import("std");
+const placement = @import("placement");
 
 const Node = @import("node.zig").Node;
 
 
-pub fn KdTree(comptime pointT: type, comptime dimesions: usize) type {
+/// The scalar type of a point is the return type of its distanceNoRoot.
+/// Points used on the esp should use f32. The ESP32-C3 has no FPU, both are soft-float there,
+/// but the f32 routines are much smaller and faster than the f64 ones.
+pub fn Scalar(comptime pointT: type) type {
     if (!@hasDecl(pointT, "distanceNoRoot")) {
-        @compileError("distanceNoRoot(pointT, pointT) f64 has to be declared on a point type.");
+        @compileError("distanceNoRoot(pointT, pointT) f32 or f64 has to be declared on a point type.");
+    }
+    const scalarT = @typeInfo(@TypeOf(@field(pointT, "distanceNoRoot"))).@"fn".return_type.?;
+    if (scalarT != f32 and scalarT != f64) {
+        @compileError("distanceNoRoot(pointT, pointT) has to return f32 or f64.");
     }
-    if (@TypeOf(@field(pointT, "distanceNoRoot")) != fn (pointT, pointT) f64) {
-        @compileError("distanceNoRoot(pointT, pointT) f64 has to be declared on a point type and have the correct signature.");
+    return scalarT;
+}
+
+/// Only the searches of point types which declare onControlPath = true are placed in IRAM,
+/// so the kd trees of benchmarks and tests don't take it up.
+pub fn onControlPath(comptime pointT: type) bool {
+    return @hasDecl(pointT, "onControlPath") and pointT.onControlPath;
+}
+
+pub fn KdTree(comptime pointT: type, comptime dimesions: usize) type {
+    const scalarT = Scalar(pointT);
+    const hot = onControlPath(pointT);
+    if (@TypeOf(@field(pointT, "distanceNoRoot")) != fn (pointT, pointT) scalarT) {
+        @compileError("distanceNoRoot(pointT, pointT) " ++ @typeName(scalarT) ++ " has to be declared on a point type and have the correct signature.");
     }
     if (!@hasDecl(pointT, "getDimension")) {
-        @compileError("getDimension(pointT, usize) f64 has to be declared on a point type.");
+        @compileError("getDimension(pointT, usize) " ++ @typeName(scalarT) ++ " has to be declared on a point type.");
     }
-    if (@TypeOf(@field(pointT, "getDimension")) != fn (pointT, usize) f64) {
-        @compileError("getDimension(pointT, usize) f64 has to be declared on a point type and have the correct signature.");
+    if (@TypeOf(@field(pointT, "getDimension")) != fn (pointT, usize) scalarT) {
+        @compileError("getDimension(pointT, usize) " ++ @typeName(scalarT) ++ " has to be declared on a point type and have the correct signature.");
     }
     const nodeT = Node(pointT, dimesions);
     return struct {
@@ -22,6 +42,11 @@ pub fn KdTree(comptime pointT: type, comptime dimesions: usize) type {
         allocator: std.mem.Allocator,
 
         const Self = @This();
+        // A subtree is rebuilt balanced when one of its children holds more than alpha = 3/4 of its nodes (scapegoat tree).
+        const alphaNumerator = 3;
+        const alphaDenominator = 4;
+        // The depth never exceeds maxBalancedDepth, which is below this for every tree that fits into memory.
+        const maxDepth = 96;
 
         pub fn init(allocator: std.mem.Allocator, points: []pointT) !Self {
             return .{
@@ -34,27 +59,95 @@ pub fn KdTree(comptime pointT: type, comptime dimesions: usize) type {
             self.root = try nodeT.initSubTree(self.allocator, points, 0);
         }
 
+        /// Inserts the point as a leaf, the splitting dimension of a node is always its depth modulo the dimensions.
+        /// When the leaf is deeper than a balanced tree allows, the lowest unbalanced subtree on its path is rebuilt,
+        /// which keeps the depth logarithmic with amortized logarithmic insertion time.
         pub fn insert(self: *Self, point: pointT) !void {
             const node: *nodeT = try self.allocator.create(nodeT);
             node.point = point;
             node.left = null;
             node.right = null;
             node.splittingDimension = 0;
+            node.size = 1;
 
-            if (self.root) |root| {
-                root.insert(node);
-            } else {
-                self.root = node;
+            // The links from the root to the parent of the new node.
+            var path: [maxDepth]*?*nodeT = undefined;
+            var depth: usize = 0;
+            var link: *?*nodeT = &self.root;
+            while (link.*) |parent| {
+                std.debug.assert(depth < maxDepth);
+                path[depth] = link;
+                depth += 1;
+                parent.size += 1;
+                node.splittingDimension = (parent.splittingDimension + 1) % dimesions;
+                link = if (point.getDimension(parent.splittingDimension) < parent.getDimension()) &parent.left else &parent.right;
+            }
+            link.* = node;
+
+            if (depth > maxBalancedDepth(self.root.?.size)) {
+                try self.rebuildScapegoat(path[0..depth]);
             }
         }
 
-        pub fn nearestNeighbor(self: Self, point: pointT) ?pointT {
+        /// At least log_(1/alpha)(size), if a leaf is deeper there is an unbalanced subtree on its path.
+        fn maxBalancedDepth(size: usize) usize {
+            return (std.math.log2_int(usize, size) + 1) * 5 / 2;
+        }
+
+        fn rebuildScapegoat(self: *Self, path: []*?*nodeT) !void {
+            var childSize: usize = 1;
+            var i = path.len;
+            while (i > 0) {
+                i -= 1;
+                const node = path[i].*.?;
+                if (childSize * alphaDenominator > node.size * alphaNumerator) {
+                    return self.rebuild(path[i]);
+                }
+                childSize = node.size;
+            }
+        }
+
+        fn rebuild(self: *Self, link: *?*nodeT) !void {
+            const subTree = link.*.?;
+            const points = try self.allocator.alloc(pointT, subTree.size);
+            defer self.allocator.free(points);
+            var index: usize = 0;
+            subTree.collect(points, &index);
+
+            link.* = try nodeT.initSubTree(self.allocator, points, subTree.splittingDimension);
+            subTree.deinitSubTree(self.allocator);
+        }
+
+        pub fn len(self: Self) usize {
+            return if (self.root) |root| root.size else 0;
+        }
+
+        pub fn nearestNeighbor(self: Self, point: pointT) linksection(placement.hotTextIf(hot, "kdTree.nearestNeighbor")) ?pointT {
             if (self.root) |root| {
                 return root.nearestNeighbor(point);
             }
             return null;
         }
 
+        /// Writes the min(neighbors.len, len()) nearest points sorted by distance into neighbors and returns them.
+        pub fn kNearest(self: Self, point: pointT, neighbors: []pointT) linksection(placement.hotTextIf(hot, "kdTree.kNearest")) []pointT {
+            var count: usize = 0;
+            if (neighbors.len != 0) {
+                if (self.root) |root| {
+                    root.kNearest(point, neighbors, &count);
+                }
+            }
+            return neighbors[0..count];
+        }
+
+        /// Appends all points within the radius around point to result, in no particular order.
+        /// The radius is compared against the square root of distanceNoRoot.
+        pub fn withinRadius(self: Self, allocator: std.mem.Allocator, point: pointT, radius: scalarT, result: *std.ArrayList(pointT)) !void {
+            if (self.root) |root| {
+                try root.withinRadius(allocator, point, radius * radius, result);
+            }
+        }
+
         pub fn print(self: Self) !void {
             const stdout = std.io.getStdOut().writer();
             try stdout.writeAll("digraph 1 {\n");
@@ -166,3 +259,127 @@ test "nearestNeighborAgainstSliceNearestNeighbor" {
         try testing.expectEqual(nnSlice.y, nn.y);
     }
 }
+
+test "nearestNeighborSinglePrecision" {
+    const Point32 = struct {
+        x: f32,
+        y: f32,
+
+        const Self = @This();
+
+        pub fn getDimension(self: Self, dimension: usize) f32 {
+            return if (dimension == 0) self.x else self.y;
+        }
+
+        pub fn distanceNoRoot(self: Self, point: Self) f32 {
+            const xDiff = self.x - point.x;
+            const yDiff = self.y - point.y;
+            return xDiff * xDiff + yDiff * yDiff;
+        }
+    };
+    try testing.expectEqual(f32, Scalar(Point32));
+
+    var points = [_]Point32{
+        .{ .x = 1, .y = 0 },
+        .{ .x = 4, .y = 4 },
+        .{ .x = 2, .y = 3 },
+        .{ .x = 9, .y = 9 },
+        .{ .x = 7, .y = 2 },
+    };
+
+    var kdTree = try KdTree(Point32, 2).init(testing.allocator, &points);
+    defer kdTree.deinit();
+
+    const nn: Point32 = kdTree.nearestNeighbor(.{ .x = 5, .y = 5 }).?;
+    try testing.expectEqual(4, nn.x);
+    try testing.expectEqual(4, nn.y);
+}
+
+fn expectBalancedSubTree(node: anytype, depth: usize) !usize {
+    try testing.expectEqual(depth % 2, node.splittingDimension);
+    var size: usize = 1;
+    if (node.left) |l| {
+        try testing.expect(l.point.getDimension(node.splittingDimension) <= node.getDimension());
+        size += try expectBalancedSubTree(l, depth + 1);
+    }
+    if (node.right) |r| {
+        try testing.expect(r.point.getDimension(node.splittingDimension) >= node.getDimension());
+        size += try expectBalancedSubTree(r, depth + 1);
+    }
+    try testing.expectEqual(size, node.size);
+    return size;
+}
+
+fn height(node: anytype) usize {
+    const leftHeight = if (node.left) |l| height(l) else 0;
+    const rightHeight = if (node.right) |r| height(r) else 0;
+    return 1 + @max(leftHeight, rightHeight);
+}
+
+test "insertSortedStaysBalanced" {
+    var kdTree = try kdTreeT.init(testing.allocator, &.{});
+    defer kdTree.deinit();
+
+    // Points along a line are the worst case for inserting without rebalancing, the tree would be a list.
+    const count = 2000;
+    for (0..count) |i| {
+        const iF64: f64 = @floatFromInt(i);
+        try kdTree.insert(.{ .x = iF64, .y = iF64 * 0.5 });
+    }
+
+    try testing.expectEqual(count, kdTree.len());
+    try testing.expectEqual(count, try expectBalancedSubTree(kdTree.root.?, 0));
+    try testing.expect(height(kdTree.root.?) <= kdTreeT.maxBalancedDepth(count) + 1);
+
+    const nn: Point = kdTree.nearestNeighbor(.{ .x = 1234.2, .y = 617.0 }).?;
+    try testing.expectEqual(1234, nn.x);
+}
+
+fn lessThanDistance(point: Point, a: Point, b: Point) bool {
+    return point.distanceNoRoot(a) < point.distanceNoRoot(b);
+}
+
+test "kNearestAndWithinRadiusAgainstSlice" {
+    const maxLength = 500;
+    var points: [maxLength]Point = undefined;
+    var sorted: [maxLength]Point = undefined;
+    var neighbors: [8]Point = undefined;
+    var prng = std.Random.DefaultPrng.init(0);
+    const rng = prng.random();
+    for (0..100) |_| {
+        const length = rng.uintAtMost(usize, maxLength);
+
+        var kdTree = try kdTreeT.init(testing.allocator, &.{});
+        defer kdTree.deinit();
+        for (0..length) |i| {
+            points[i] = .{ .x = rng.float(f64) * 100.0, .y = rng.float(f64) * 100.0 };
+            try kdTree.insert(points[i]);
+        }
+
+        const point: Point = .{ .x = rng.float(f64) * 100.0, .y = rng.float(f64) * 100.0 };
+        @memcpy(sorted[0..length], points[0..length]);
+        std.mem.sort(Point, sorted[0..length], point, lessThanDistance);
+
+        const k = rng.uintAtMost(usize, neighbors.len);
+        const kNearest = kdTree.kNearest(point, neighbors[0..k]);
+        try testing.expectEqual(@min(k, length), kNearest.len);
+        for (kNearest, sorted[0..kNearest.len]) |neighbor, expected| {
+            try testing.expectEqual(point.distanceNoRoot(expected), point.distanceNoRoot(neighbor));
+        }
+
+        const radius = rng.float(f64) * 30.0;
+        var withinRadius = try std.ArrayList(Point).initCapacity(testing.allocator, 10);
+        defer withinRadius.deinit(testing.allocator);
+        try kdTree.withinRadius(testing.allocator, point, radius, &withinRadius);
+        var expectedCount: usize = 0;
+        for (sorted[0..length]) |p| {
+            if (point.distanceNoRoot(p) <= radius * radius) {
+                expectedCount += 1;
+            }
+        }
+        try testing.expectEqual(expectedCount, withinRadius.items.len);
+        for (withinRadius.items) |p| {
+            try testing.expect(point.distanceNoRoot(p) <= radius * radius);
+        }
+    }
+}
@@ -1,7 +1,12 @@
 const std = @import("std");
+const placement = @import("placement");
+const kdTreeMod = @import("kdTree.zig");
+const Scalar = kdTreeMod.Scalar;
 
 
 pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
+    const scalarT = Scalar(pointT);
+    const hot = kdTreeMod.onControlPath(pointT);
     return struct {
         const Self = @This();
 
@@ -9,8 +14,10 @@ pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
         left: ?*Self,
         right: ?*Self,
         splittingDimension: usize,
+        // Number of nodes in the subtree of this node including itself.
+        size: usize,
 
-        fn getDimension(self: Self) f64 {
+        pub fn getDimension(self: Self) linksection(placement.hotTextIf(hot, "kdTree.node.getDimension")) scalarT {
             return self.point.getDimension(self.splittingDimension);
         }
 
@@ -24,6 +31,7 @@ pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
                 node.left = null;
                 node.right = null;
                 node.splittingDimension = dimension;
+                node.size = 1;
                 return node;
             }
 
@@ -33,29 +41,25 @@ pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
             node.left = try Self.initSubTree(allocator, points[0..pivotIndex], newDimension);
             node.right = try Self.initSubTree(allocator, points[pivotIndex + 1 ..], newDimension);
             node.splittingDimension = dimension;
+            node.size = points.len;
             return node;
         }
 
-        pub fn insert(self: *Self, node: *Self) void {
-            node.splittingDimension = (node.splittingDimension + 1) % dimesions;
-            if (node.getDimension() < self.getDimension()) {
-                if (self.left) |l| {
-                    l.insert(node);
-                } else {
-                    self.left = node;
-                }
-            } else {
-                if (self.right) |r| {
-                    r.insert(node);
-                } else {
-                    self.right = node;
-                }
+        /// Copies the points of the subtree into points in order, index is the next free index.
+        pub fn collect(self: Self, points: []pointT, index: *usize) void {
+            if (self.left) |l| {
+                l.collect(points, index);
+            }
+            points[index.*] = self.point;
+            index.* += 1;
+            if (self.right) |r| {
+                r.collect(points, index);
             }
         }
 
-        pub fn nearestNeighbor(self: Self, point: pointT) pointT {
-            const treeValue: f64 = self.getDimension();
-            const value: f64 = point.getDimension(self.splittingDimension);
+        pub fn nearestNeighbor(self: Self, point: pointT) linksection(placement.hotTextIf(hot, "kdTree.node.nearestNeighbor")) pointT {
+            const treeValue: scalarT = self.getDimension();
+            const value: scalarT = point.getDimension(self.splittingDimension);
 
             var nn: pointT = self.point;
             var otherSubtree: ?*Self = null;
@@ -88,6 +92,62 @@ pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
             return nn;
         }
 
+        /// neighbors[0..count] is sorted by the distance to point, the nearer points of the subtree are inserted.
+        pub fn kNearest(self: Self, point: pointT, neighbors: []pointT, count: *usize) linksection(placement.hotTextIf(hot, "kdTree.node.kNearest")) void {
+            const treeValue: scalarT = self.getDimension();
+            const value: scalarT = point.getDimension(self.splittingDimension);
+            const nearSubtree, const otherSubtree = if (value < treeValue) .{ self.left, self.right } else .{ self.right, self.left };
+
+            if (nearSubtree) |node| {
+                node.kNearest(point, neighbors, count);
+            }
+            insertSorted(point, self.point, neighbors, count);
+
+            if (otherSubtree) |node| {
+                if (count.* < neighbors.len or (treeValue - value) * (treeValue - value) < point.distanceNoRoot(neighbors[count.* - 1])) {
+                    node.kNearest(point, neighbors, count);
+                }
+            }
+        }
+
+        fn insertSorted(point: pointT, candidate: pointT, neighbors: []pointT, count: *usize) linksection(placement.hotTextIf(hot, "kdTree.node.insertSorted")) void {
+            const distance = point.distanceNoRoot(candidate);
+            var i = count.*;
+            if (i == neighbors.len) {
+                if (distance >= point.distanceNoRoot(neighbors[i - 1])) {
+                    return;
+                }
+                i -= 1;
+            } else {
+                count.* += 1;
+            }
+            while (i > 0 and point.distanceNoRoot(neighbors[i - 1]) > distance) : (i -= 1) {
+                neighbors[i] = neighbors[i - 1];
+            }
+            neighbors[i] = candidate;
+        }
+
+        /// Appends all points of the subtree whose distanceNoRoot to point is at most radiusNoRoot.
+        pub fn withinRadius(self: Self, allocator: std.mem.Allocator, point: pointT, radiusNoRoot: scalarT, result: *std.ArrayList(pointT)) !void {
+            const treeValue: scalarT = self.getDimension();
+            const value: scalarT = point.getDimension(self.splittingDimension);
+            const planeDistance = (treeValue - value) * (treeValue - value);
+
+            if (point.distanceNoRoot(self.point) <= radiusNoRoot) {
+                try result.append(allocator, self.point);
+            }
+            if (self.left) |l| {
+                if (value < treeValue or planeDistance <= radiusNoRoot) {
+                    try l.withinRadius(allocator, point, radiusNoRoot, result);
+                }
+            }
+            if (self.right) |r| {
+                if (value >= treeValue or planeDistance <= radiusNoRoot) {
+                    try r.withinRadius(allocator, point, radiusNoRoot, result);
+                }
+            }
+        }
+
         pub fn print(self: Self, allocator: std.mem.Allocator, id: usize) !usize {
             const stdout = std.io.getStdOut().writer();
             var arrayList = std.ArrayList(u8).init(allocator);
@@ -141,7 +201,7 @@ pub fn Node(comptime pointT: type, comptime dimesions: usize) type {
         }
 
         fn partition(points: []pointT, dimension: usize) usize {
-            const pivot: f64 = points[points.len - 1].getDimension(dimension);
+            const pivot: scalarT = points[points.len - 1].getDimension(dimension);
             var i: usize = 0;
 
             for (i..points.len - 1) |j| {
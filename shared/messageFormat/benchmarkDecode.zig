@@ -0,0 +1,112 @@
+const std = @import("std");
+const encode = @import("encode.zig");
+const decode = @import("decode.zig");
+
+// Shaped like the telemetry of the controller: mostly fixed size measurements, now and then a log line.
+const Measurement = struct {
+    time: u32,
+    heading: f32,
+    accelerationX: f32,
+    accelerationY: f32,
+    accelerationZ: f32,
+    velocity: f32,
+    distance: f32,
+};
+
+const Log = struct {
+    message: []u8,
+};
+
+const ContractEnum = enum(u8) {
+    measurement,
+    log,
+};
+
+const Contract = union(ContractEnum) {
+    measurement: Measurement,
+    log: Log,
+};
+
+const Handler = struct {
+    allocator: std.mem.Allocator,
+    received: usize,
+    checksum: f32,
+
+    pub fn handleMeasurement(self: *Handler, measurement: Measurement) !void {
+        self.received += 1;
+        self.checksum += measurement.velocity;
+    }
+
+    pub fn handleLog(self: *Handler, log: Log) !void {
+        self.received += 1;
+        self.allocator.free(log.message);
+    }
+};
+
+const streamSize = 64 * 1024 * 1024;
+const logEvery = 100;
+
+/// Feeds streamSize bytes of concatenated messages to the decoder in random chunk sizes up to maxChunkSize
+/// and prints the throughput. maxChunkSize 1 splits every message and every length prefix.
+fn run(allocator: std.mem.Allocator, stream: []const u8, messageCount: usize, maxChunkSize: usize, writer: *std.Io.Writer) !void {
+    var prng = std.Random.DefaultPrng.init(maxChunkSize);
+    const rng = prng.random();
+    var handler: Handler = .{ .allocator = allocator, .received = 0, .checksum = 0.0 };
+    var decoder = decode.Decoder(ContractEnum, Contract, Handler).init(allocator, &handler);
+
+    var timer = try std.time.Timer.start();
+    var index: usize = 0;
+    while (index < stream.len) {
+        const chunkSize = @min(rng.intRangeAtMost(usize, 1, maxChunkSize), stream.len - index);
+        try decoder.decode(stream[index .. index + chunkSize]);
+        index += chunkSize;
+    }
+    const seconds = @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_s;
+
+    if (handler.received != messageCount) {
+        return error.MessagesLost;
+    }
+    const megabytes = @as(f64, @floatFromInt(stream.len)) / (1024 * 1024);
+    try writer.print("chunks up to {d:>6} bytes: {d:>8.2} M messages/s, {d:>8.1} MiB/s\n", .{
+        maxChunkSize,
+        @as(f64, @floatFromInt(messageCount)) / seconds / 1e6,
+        megabytes / seconds,
+    });
+    try writer.flush();
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    var stdoutBuffer: [1024]u8 = undefined;
+    var stdoutWriter = std.fs.File.stdout().writer(&stdoutBuffer);
+    const writer = &stdoutWriter.interface;
+
+    const Encoder = encode.Encoder(Contract);
+    var stream = try std.ArrayList(u8).initCapacity(allocator, streamSize);
+    defer stream.deinit(allocator);
+    var logMessage = [_]u8{'x'} ** 64;
+    var messageCount: usize = 0;
+    while (stream.items.len < streamSize - encode.MAX_MESSAGE_LENGTH) : (messageCount += 1) {
+        const encoded = if (messageCount % logEvery == 0)
+            try Encoder.encode(Log, .{ .message = &logMessage })
+        else
+            try Encoder.encode(Measurement, .{
+                .time = @truncate(messageCount),
+                .heading = 1.0,
+                .accelerationX = 0.1,
+                .accelerationY = 0.2,
+                .accelerationZ = 9.81,
+                .velocity = 1.5,
+                .distance = 3.0,
+            });
+        try stream.appendSlice(allocator, encoded);
+    }
+    try writer.print("{d} messages, {d} MiB\n", .{ messageCount, stream.items.len / (1024 * 1024) });
+
+    for ([_]usize{ 1, 16, 256, 4096, 65536 }) |maxChunkSize| {
+        try run(allocator, stream.items, messageCount, maxChunkSize, writer);
+    }
+}
@@ -1,13 +1,16 @@
 const std = @import("std");
+const builtin = @import("builtin");
 
 pub const MAX_MESSAGE_LENGTH = 1000;
 pub const TERMINATION_BYTE = 0xAA;
+const LENGTH_PREFIX_SIZE = 2;
 
 pub const MessageFormatError = error{
     MessageToLong,
     ListTooLong,
     WrongTerminationByte,
     MessageLargerThenExpected,
+    MessageShorterThenExpected,
     TagTooLarge,
     NotSupportedDataType,
 };
@@ -28,73 +31,117 @@ pub fn Decoder(comptime contractEnumT: type, comptime contractT: type, comptime
         allocator: std.mem.Allocator,
         handler: *handlerT,
 
-        messageLength: ?usize,
+        // Only a message which is split over several calls of decode is collected here, length prefix included.
+        // Complete messages are decoded directly from the bytes passed to decode.
+        buffer: [MAX_MESSAGE_LENGTH]u8,
         byteCount: usize,
-
-        var array: [MAX_MESSAGE_LENGTH]u8 = undefined;
-        var internalBuffer: []u8 = &array;
+        // Length of the collected message without the prefix, known once both bytes of the prefix arrived.
+        messageLength: ?usize,
+        // Set by decodeSkippingErrors after a malformed message until the next termination byte.
+        skipping: bool,
 
         const Self = @This();
 
         pub fn init(allocator: std.mem.Allocator, handler: *handlerT) Self {
-            return .{ .allocator = allocator, .handler = handler, .messageLength = null, .byteCount = 0 };
+            return .{ .allocator = allocator, .handler = handler, .buffer = undefined, .byteCount = 0, .messageLength = null, .skipping = false };
         }
 
-        pub fn decode(self: *Self, _bytes: []const u8) !void {
-            var bytes = _bytes;
-            if (self.messageLength == null) {
-                if (bytes.len + self.byteCount < 2) {
-                    if (bytes.len == 0) {} else if (bytes.len == 1) {
-                        internalBuffer[self.byteCount] = bytes[0];
-                        self.byteCount += 1;
-                    } else {
-                        unreachable;
-                    }
-                    return;
-                } else if (self.byteCount == 1) {
-                    internalBuffer[self.byteCount] = bytes[0];
-                    try self.decodeMessageLength(internalBuffer);
-                    self.byteCount = 0;
-                    if (bytes.len == 1) {
-                        return;
+        /// Decodes every message completed by bytes and calls the handler for each, in order.
+        /// bytes can end anywhere, also inside the length prefix, the rest is kept until the next call.
+        /// On an error the partially collected message and the rest of bytes are dropped.
+        pub fn decode(self: *Self, bytes: []const u8) !void {
+            errdefer self.reset();
+            var rest = bytes;
+            try self.decodeRest(&rest);
+        }
+
+        /// For links without connections, like a serial line, which can be opened in the middle of a message
+        /// and have no checksum below the message format.
+        /// After a malformed message everything up to and including the next termination byte is skipped,
+        /// also across calls, and decoding continues after it. A termination byte inside a payload can make it
+        /// continue in the middle of a message, which then fails and is skipped again.
+        /// Returns the number of malformed messages, errors of the handler are returned.
+        pub fn decodeSkippingErrors(self: *Self, bytes: []const u8) !usize {
+            var errorCount: usize = 0;
+            var rest = bytes;
+            while (rest.len > 0) {
+                if (self.skipping) {
+                    const end = std.mem.indexOfScalar(u8, rest, TERMINATION_BYTE) orelse return errorCount;
+                    rest = rest[end + 1 ..];
+                    self.skipping = false;
+                }
+                self.decodeRest(&rest) catch |err| {
+                    self.reset();
+                    if (!isMessageFormatError(err)) {
+                        return err;
                     }
-                    bytes = bytes[1..];
-                } else if (bytes.len >= 2) {
-                    try self.decodeMessageLength(bytes);
-                    if (bytes.len == 2) {
-                        return;
+                    errorCount += 1;
+                    self.skipping = true;
+                };
+            }
+            return errorCount;
+        }
+
+        /// Drops the partially collected message and skips to the next termination byte in decodeSkippingErrors,
+        /// for links which lost bytes.
+        pub fn resynchronize(self: *Self) void {
+            self.reset();
+            self.skipping = true;
+        }
+
+        /// Decodes until rest is empty, on an error rest starts at the message which failed or after the bytes
+        /// which were collected for it.
+        fn decodeRest(self: *Self, rest: *[]const u8) !void {
+            while (rest.len > 0) {
+                if (self.byteCount == 0 and rest.len >= LENGTH_PREFIX_SIZE) {
+                    const messageLength = try readMessageLength(rest.*[0..LENGTH_PREFIX_SIZE]);
+                    const frameLength = LENGTH_PREFIX_SIZE + messageLength;
+                    if (rest.len >= frameLength) {
+                        try self.decodeMessage(rest.*[LENGTH_PREFIX_SIZE..frameLength]);
+                        rest.* = rest.*[frameLength..];
+                        continue;
                     }
-                    bytes = bytes[2..];
-                } else {
-                    unreachable;
                 }
+                try self.collect(rest);
             }
+        }
 
-            if (self.byteCount > 0) {
-                const bytesNeeded = self.messageLength.? - self.byteCount;
-                if (bytes.len < bytesNeeded) {
-                    @memcpy(internalBuffer[self.byteCount .. self.byteCount + bytes.len], bytes);
-                    self.byteCount += bytes.len;
-                } else if (bytes.len == bytesNeeded) {
-                    @memcpy(internalBuffer[self.byteCount .. self.byteCount + bytesNeeded], bytes);
-                    try self.decodeMessage(internalBuffer);
-                } else {
-                    @memcpy(internalBuffer[self.byteCount .. self.byteCount + bytesNeeded], bytes[0..bytesNeeded]);
-                    try self.decodeMessage(internalBuffer);
-                    try self.decode(bytes[bytesNeeded..]);
+        /// Copies as much of the current message as rest holds into the buffer and decodes it once it is complete.
+        /// rest is advanced past the copied bytes.
+        fn collect(self: *Self, rest: *[]const u8) !void {
+            if (self.messageLength == null) {
+                const count = @min(LENGTH_PREFIX_SIZE - self.byteCount, rest.len);
+                @memcpy(self.buffer[self.byteCount..][0..count], rest.*[0..count]);
+                self.byteCount += count;
+                rest.* = rest.*[count..];
+                if (self.byteCount < LENGTH_PREFIX_SIZE) {
+                    return;
                 }
-            } else {
-                if (bytes.len < self.messageLength.?) {
-                    @memcpy(internalBuffer[0..bytes.len], bytes);
-                    self.byteCount = bytes.len;
-                } else if (bytes.len == self.messageLength.?) {
-                    try self.decodeMessage(bytes);
-                } else {
-                    const toDecodeBytes = bytes[self.messageLength.?..];
-                    try self.decodeMessage(bytes);
-                    try self.decode(toDecodeBytes);
+                self.messageLength = try readMessageLength(self.buffer[0..LENGTH_PREFIX_SIZE]);
+            }
+            const frameLength = LENGTH_PREFIX_SIZE + self.messageLength.?;
+            const count = @min(frameLength - self.byteCount, rest.len);
+            @memcpy(self.buffer[self.byteCount..][0..count], rest.*[0..count]);
+            self.byteCount += count;
+            rest.* = rest.*[count..];
+            if (self.byteCount == frameLength) {
+                self.reset();
+                try self.decodeMessage(self.buffer[LENGTH_PREFIX_SIZE..frameLength]);
+            }
+        }
+
+        fn isMessageFormatError(err: anyerror) bool {
+            inline for (@typeInfo(MessageFormatError).error_set.?) |formatError| {
+                if (err == @field(MessageFormatError, formatError.name)) {
+                    return true;
                 }
             }
+            return false;
+        }
+
+        fn reset(self: *Self) void {
+            self.byteCount = 0;
+            self.messageLength = null;
         }
 
         fn callHandler(self: *Self, decoded: contractT) !void {
@@ -107,50 +154,72 @@ pub fn Decoder(comptime contractEnumT: type, comptime contractT: type, comptime
             }
         }
 
-        fn decodeMessageLength(self: *Self, buffer: []const u8) !void {
-            var index: usize = 0;
-            self.messageLength = try self.decodeType(u16, buffer, &index);
-            if (self.messageLength.? > MAX_MESSAGE_LENGTH - 2) {
+        /// The length of a message counts the payload and the termination byte.
+        /// It is in native byte order like everything else the encoder writes.
+        fn readMessageLength(prefix: *const [LENGTH_PREFIX_SIZE]u8) !usize {
+            const messageLength = std.mem.readInt(u16, prefix, builtin.cpu.arch.endian());
+            if (messageLength == 0) {
+                return MessageFormatError.MessageShorterThenExpected;
+            }
+            if (messageLength > MAX_MESSAGE_LENGTH - LENGTH_PREFIX_SIZE) {
                 return MessageFormatError.MessageToLong;
             }
+            return messageLength;
         }
 
-        fn decodeMessage(self: *Self, buffer: []const u8) !void {
-            if (self.messageLength.? - 1 >= buffer.len) {
-                return MessageFormatError.MessageLargerThenExpected;
-            }
-            if (buffer[self.messageLength.? - 1] != TERMINATION_BYTE) {
+        /// message is the payload followed by the termination byte.
+        fn decodeMessage(self: *Self, message: []const u8) !void {
+            if (message[message.len - 1] != TERMINATION_BYTE) {
                 return MessageFormatError.WrongTerminationByte;
             }
+            const payload = message[0 .. message.len - 1];
             var index: usize = 0;
-            const decoded = try self.decodeType(contractT, buffer, &index);
-            self.byteCount = 0;
-            self.messageLength = null;
+            const decoded = try self.decodeType(contractT, payload, &index);
+            if (index != payload.len) {
+                self.free(contractT, decoded);
+                return MessageFormatError.MessageLargerThenExpected;
+            }
             try self.callHandler(decoded);
         }
 
-        pub fn decodeType(self: Self, comptime T: type, buffer: []const u8, index: *usize) !T {
+        /// On an error everything allocated for the value so far is freed.
+        pub fn decodeType(self: *const Self, comptime T: type, buffer: []const u8, index: *usize) !T {
             const typeInfo = @typeInfo(T);
             if (typeInfo == .@"struct") {
                 var decodeStruct: T = undefined;
+                var decodedFields: usize = 0;
+                errdefer {
+                    inline for (typeInfo.@"struct".fields, 0..) |field, i| {
+                        if (i < decodedFields) {
+                            self.free(field.type, @field(decodeStruct, field.name));
+                        }
+                    }
+                }
                 inline for (typeInfo.@"struct".fields) |field| {
                     @field(decodeStruct, field.name) = try self.decodeType(field.type, buffer, index);
+                    decodedFields += 1;
                 }
                 return decodeStruct;
             }
             if (typeInfo == .@"pointer" and typeInfo.@"pointer".size == .@"slice") {
-                const length: u8 = buffer[index.*];
-                index.* += 1;
+                const length: u8 = (try readBytes(buffer, index, 1))[0];
                 const slice: []typeInfo.@"pointer".child = try self.allocator.alloc(typeInfo.@"pointer".child, length);
+                var decodedElements: usize = 0;
+                errdefer {
+                    for (slice[0..decodedElements]) |element| {
+                        self.free(typeInfo.@"pointer".child, element);
+                    }
+                    self.allocator.free(slice);
+                }
                 for (0..length) |i| {
                     const childValue: typeInfo.@"pointer".child = try self.decodeType(typeInfo.@"pointer".child, buffer, index);
                     slice[i] = childValue;
+                    decodedElements += 1;
                 }
                 return slice;
             }
             if (typeInfo == .@"union" and typeInfo.@"union".tag_type != null) {
-                const tag = buffer[index.*];
-                index.* += 1;
+                const tag = (try readBytes(buffer, index, 1))[0];
 
                 var decodeUnion: T = undefined;
                 if (tag >= typeInfo.@"union".fields.len) {
@@ -165,26 +234,47 @@ pub fn Decoder(comptime contractEnumT: type, comptime contractT: type, comptime
                 return decodeUnion;
             }
             if (typeInfo == .@"enum") {
-                const tag = buffer[index.*];
-                index.* += 1;
-                const enumWithTag: T = @enumFromInt(tag);
-                return enumWithTag;
+                const tag = (try readBytes(buffer, index, 1))[0];
+                return std.meta.intToEnum(T, tag) catch MessageFormatError.TagTooLarge;
             }
             if (T == u8) {
-                const number = buffer[index.*];
-                index.* += 1;
-                return number;
+                return (try readBytes(buffer, index, 1))[0];
             }
             if (typeInfo == .@"float" or typeInfo == .@"int") {
+                // The bytes have no alignment in the message, bytesToValue copies them.
                 const byteSize = @sizeOf(T);
-                var bytes: [byteSize]u8 = undefined;
-                const bytesPtr: *[byteSize]u8 = &bytes;
-                @memcpy(bytesPtr, buffer[index.* .. index.* + byteSize]);
-                const number: *T = @ptrCast(@alignCast(bytesPtr));
-                index.* += byteSize;
-                return number.*;
+                return std.mem.bytesToValue(T, (try readBytes(buffer, index, byteSize))[0..byteSize]);
             }
             return MessageFormatError.NotSupportedDataType;
         }
+
+        /// Frees what decodeType allocated for value.
+        pub fn free(self: *const Self, comptime T: type, value: T) void {
+            const typeInfo = @typeInfo(T);
+            if (typeInfo == .@"struct") {
+                inline for (typeInfo.@"struct".fields) |field| {
+                    self.free(field.type, @field(value, field.name));
+                }
+            } else if (typeInfo == .@"pointer" and typeInfo.@"pointer".size == .@"slice") {
+                for (value) |element| {
+                    self.free(typeInfo.@"pointer".child, element);
+                }
+                self.allocator.free(value);
+            } else if (typeInfo == .@"union" and typeInfo.@"union".tag_type != null) {
+                switch (value) {
+                    inline else => |payload| self.free(@TypeOf(payload), payload),
+                }
+            }
+        }
+
+        /// A corrupted length or tag must not read past the message.
+        fn readBytes(buffer: []const u8, index: *usize, count: usize) ![]const u8 {
+            if (buffer.len - index.* < count) {
+                return MessageFormatError.MessageShorterThenExpected;
+            }
+            const bytes = buffer[index.*..][0..count];
+            index.* += count;
+            return bytes;
+        }
     };
 }
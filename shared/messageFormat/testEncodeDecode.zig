@@ -137,3 +137,227 @@ test "TestEncoderDecoder" {
 
     encodedMessages.deinit(allocator);
 }
+
+const Sample = struct {
+    sequence: u32,
+    value: f32,
+};
+
+const Text = struct {
+    sequence: u32,
+    message: []u8,
+};
+
+const StreamContractEnum = enum(u8) {
+    sample,
+    text,
+};
+
+const StreamContract = union(StreamContractEnum) {
+    sample: Sample,
+    text: Text,
+};
+
+/// Every message is derived from its sequence number, so the handler can check it without storing what was sent.
+fn streamMessage(sequence: u32, buffer: []u8) StreamContract {
+    if (sequence % 3 == 0) {
+        return .{ .sample = .{ .sequence = sequence, .value = @floatFromInt(sequence) } };
+    }
+    const message = buffer[0 .. sequence % buffer.len];
+    for (message, 0..) |*byte, i| {
+        byte.* = @truncate(sequence +% i);
+    }
+    return .{ .text = .{ .sequence = sequence, .message = message } };
+}
+
+const StreamHandler = struct {
+    allocator: std.mem.Allocator,
+    received: u32,
+
+    pub fn handleSample(self: *StreamHandler, sample: Sample) !void {
+        try std.testing.expectEqual(self.received, sample.sequence);
+        try std.testing.expectEqual(@as(f32, @floatFromInt(sample.sequence)), sample.value);
+        self.received += 1;
+    }
+
+    pub fn handleText(self: *StreamHandler, text: Text) !void {
+        defer self.allocator.free(text.message);
+        var buffer: [255]u8 = undefined;
+        try std.testing.expectEqual(self.received, text.sequence);
+        try std.testing.expectEqualSlices(u8, streamMessage(text.sequence, &buffer).text.message, text.message);
+        self.received += 1;
+    }
+};
+
+fn encodeStream(allocator: std.mem.Allocator, messageCount: u32) !std.ArrayList(u8) {
+    const Encoder = encode.Encoder(StreamContract);
+    var stream = try std.ArrayList(u8).initCapacity(allocator, 0);
+    errdefer stream.deinit(allocator);
+    var buffer: [255]u8 = undefined;
+    for (0..messageCount) |i| {
+        const encoded = switch (streamMessage(@intCast(i), &buffer)) {
+            inline else => |message| try Encoder.encode(@TypeOf(message), message),
+        };
+        try stream.appendSlice(allocator, encoded);
+    }
+    return stream;
+}
+
+test "TestDecoderArbitraryChunks" {
+    const allocator = std.testing.allocator;
+    const messageCount = 2000;
+    var stream = try encodeStream(allocator, messageCount);
+    defer stream.deinit(allocator);
+
+    var prng = std.Random.DefaultPrng.init(0);
+    const rng = prng.random();
+    // From single bytes, which split every length prefix, to chunks holding many messages.
+    for ([_]usize{ 1, 3, 16, 300, 4096 }) |maxChunkSize| {
+        var handler: StreamHandler = .{ .allocator = allocator, .received = 0 };
+        var decoder = decode.Decoder(StreamContractEnum, StreamContract, StreamHandler).init(allocator, &handler);
+        var index: usize = 0;
+        while (index < stream.items.len) {
+            const chunkSize = @min(rng.intRangeAtMost(usize, 0, maxChunkSize), stream.items.len - index);
+            try decoder.decode(stream.items[index .. index + chunkSize]);
+            index += chunkSize;
+        }
+        try std.testing.expectEqual(messageCount, handler.received);
+        try std.testing.expectEqual(0, decoder.byteCount);
+    }
+}
+
+test "TestDecoderRecoversAfterError" {
+    const allocator = std.testing.allocator;
+    var stream = try encodeStream(allocator, 2);
+    defer stream.deinit(allocator);
+    const firstLength = 2 + @as(usize, std.mem.bytesToValue(u16, stream.items[0..2]));
+
+    var handler: StreamHandler = .{ .allocator = allocator, .received = 0 };
+    var decoder = decode.Decoder(StreamContractEnum, StreamContract, StreamHandler).init(allocator, &handler);
+
+    stream.items[firstLength - 1] = 0;
+    try decoder.decode(stream.items[0..1]);
+    try std.testing.expectError(decode.MessageFormatError.WrongTerminationByte, decoder.decode(stream.items[1..firstLength]));
+    try std.testing.expectEqual(0, handler.received);
+
+    handler.received = 1;
+    try decoder.decode(stream.items[firstLength..]);
+    try std.testing.expectEqual(2, handler.received);
+
+    const tooLong = [_]u8{ 0xFF, 0xFF };
+    try std.testing.expectError(decode.MessageFormatError.MessageToLong, decoder.decode(&tooLong));
+}
+
+test "TestDecoderSkippingErrorsResynchronizes" {
+    const allocator = std.testing.allocator;
+    const messageCount = 500;
+    var stream = try encodeStream(allocator, messageCount);
+    defer stream.deinit(allocator);
+    const firstLength = 2 + @as(usize, std.mem.bytesToValue(u16, stream.items[0..2]));
+
+    var prng = std.Random.DefaultPrng.init(1);
+    const rng = prng.random();
+    for ([_]usize{ 1, 3, 16, 300, 4096 }) |maxChunkSize| {
+        // Opened after the prefix and the tag of the second message, it is lost and decoding continues with the third.
+        var handler: StreamHandler = .{ .allocator = allocator, .received = 2 };
+        var decoder = decode.Decoder(StreamContractEnum, StreamContract, StreamHandler).init(allocator, &handler);
+        var errorCount: usize = 0;
+        var index: usize = firstLength + 3;
+        while (index < stream.items.len) {
+            const chunkSize = @min(rng.intRangeAtMost(usize, 0, maxChunkSize), stream.items.len - index);
+            errorCount += try decoder.decodeSkippingErrors(stream.items[index .. index + chunkSize]);
+            index += chunkSize;
+        }
+        try std.testing.expectEqual(messageCount, handler.received);
+        try std.testing.expectEqual(1, errorCount);
+        try std.testing.expectEqual(0, decoder.byteCount);
+    }
+}
+
+test "TestDecoderResynchronize" {
+    const allocator = std.testing.allocator;
+    var stream = try encodeStream(allocator, 3);
+    defer stream.deinit(allocator);
+    const firstLength = 2 + @as(usize, std.mem.bytesToValue(u16, stream.items[0..2]));
+
+    var handler: StreamHandler = .{ .allocator = allocator, .received = 1 };
+    var decoder = decode.Decoder(StreamContractEnum, StreamContract, StreamHandler).init(allocator, &handler);
+    // The link lost the end of the first message, the rest of it is skipped instead of completing the collected part.
+    try std.testing.expectEqual(0, try decoder.decodeSkippingErrors(stream.items[0 .. firstLength - 2]));
+    decoder.resynchronize();
+    try std.testing.expectEqual(0, try decoder.decodeSkippingErrors(stream.items[firstLength - 1 ..]));
+    try std.testing.expectEqual(3, handler.received);
+}
+
+const Words = struct {
+    words: [][]u8,
+    numbers: []u32,
+    name: []u8,
+};
+
+const WordsContractEnum = enum(u8) {
+    words,
+};
+
+const WordsContract = union(WordsContractEnum) {
+    words: Words,
+};
+
+const WordsHandler = struct {
+    allocator: std.mem.Allocator,
+
+    pub fn handleWords(self: *WordsHandler, words: Words) !void {
+        for (words.words) |word| {
+            self.allocator.free(word);
+        }
+        self.allocator.free(words.words);
+        self.allocator.free(words.numbers);
+        self.allocator.free(words.name);
+    }
+};
+
+/// Frames the first payloadLength bytes of the payload of encoded as a message of its own.
+fn reframe(allocator: std.mem.Allocator, encoded: []const u8, payloadLength: usize, extraByte: bool) !std.ArrayList(u8) {
+    var frame = try std.ArrayList(u8).initCapacity(allocator, 0);
+    errdefer frame.deinit(allocator);
+    const messageLength: u16 = @intCast(payloadLength + @intFromBool(extraByte) + 1);
+    try frame.appendSlice(allocator, std.mem.asBytes(&messageLength));
+    try frame.appendSlice(allocator, encoded[2..][0..payloadLength]);
+    if (extraByte) {
+        try frame.append(allocator, 0);
+    }
+    try frame.append(allocator, decode.TERMINATION_BYTE);
+    return frame;
+}
+
+test "TestDecoderFreesTruncatedMessages" {
+    const allocator = std.testing.allocator;
+    const Encoder = encode.Encoder(WordsContract);
+
+    var first = [_]u8{ 'a', 'b', 'c' };
+    var second = [_]u8{ 'd', 'e' };
+    var words = [_][]u8{ &first, &second };
+    var numbers = [_]u32{ 1, 2, 3 };
+    var name = [_]u8{ 'x', 'y', 'z' };
+    const encoded = try Encoder.encode(Words, .{ .words = &words, .numbers = &numbers, .name = &name });
+    const payloadLength = encoded.len - 3;
+
+    var handler: WordsHandler = .{ .allocator = allocator };
+    var decoder = decode.Decoder(WordsContractEnum, WordsContract, WordsHandler).init(allocator, &handler);
+
+    // Cut inside the second word, inside the numbers and inside the name, after every slice before it was allocated.
+    const tagAndWords = 1 + 1 + (1 + first.len) + (1 + second.len);
+    for ([_]usize{ tagAndWords - 1, tagAndWords + 1 + 4, payloadLength - 1 }) |truncatedLength| {
+        var frame = try reframe(allocator, encoded, truncatedLength, false);
+        defer frame.deinit(allocator);
+        try std.testing.expectError(decode.MessageFormatError.MessageShorterThenExpected, decoder.decode(frame.items));
+    }
+
+    var longer = try reframe(allocator, encoded, payloadLength, true);
+    defer longer.deinit(allocator);
+    try std.testing.expectError(decode.MessageFormatError.MessageLargerThenExpected, decoder.decode(longer.items));
+
+    var complete = try reframe(allocator, encoded, payloadLength, false);
+    defer complete.deinit(allocator);
+    try decoder.decode(complete.items);
+}
@@ -0,0 +1,255 @@
+const std = @import("std");
+const placement = @import("placement");
+
+/// Localizes the car on the track by its distance with particles, so unlike the kalman filter
+/// it can follow several hypotheses at once on tracks with repeated curve shapes until the motion rules them out.
+/// The particles are stored as structure of arrays and weighted by the likelihood of the measured heading
+/// against the heading of the track at their distance, in @Vector kernels.
+/// particleCount is comptime, so the esp can run a small count and the host a much larger one.
+pub fn ParticleFilter(comptime particleCount: usize) type {
+    const lanes = std.simd.suggestVectorLength(f32) orelse 4;
+    if (particleCount == 0 or particleCount % lanes != 0) {
+        @compileError(std.fmt.comptimePrint("particleCount has to be a multiple of the vector length {d}.", .{lanes}));
+    }
+    const V = @Vector(lanes, f32);
+    const IndexV = @Vector(lanes, u32);
+    // The heading of the track is sampled into a table, Track.distanceToHeading searches linearly.
+    const headingTableSize = 512;
+
+    return struct {
+        const Self = @This();
+
+        distances: [particleCount]f32,
+        velocities: [particleCount]f32,
+        weights: [particleCount]f32,
+        // Resampling copies into these.
+        resampledDistances: [particleCount]f32,
+        resampledVelocities: [particleCount]f32,
+        headingTable: [headingTableSize + 1]f32,
+        trackLength: f32,
+        prng: std.Random.DefaultPrng,
+        // Standard deviation of the velocity of a particle around the measured velocity in m/s.
+        velocityNoise: f32,
+        // Standard deviation of the measured heading in degrees.
+        headingNoise: f32,
+
+        // Weighted mean and variance of the particles after the last update.
+        distance: f32,
+        velocity: f32,
+        distanceVariance: f32,
+
+        /// Fills self in place, the arrays are too large to be returned on the stack of the esp.
+        /// The particles start spread over the whole track.
+        pub fn init(self: *Self, track: anytype, seed: u64, velocityNoise: f32, headingNoise: f32) void {
+            self.trackLength = track.getTrackLength();
+            for (&self.headingTable, 0..) |*heading, i| {
+                const iF32: f32 = @floatFromInt(i);
+                heading.* = track.distanceToHeading(@min(iF32 * self.trackLength / headingTableSize, self.trackLength));
+            }
+            self.prng = std.Random.DefaultPrng.init(seed);
+            self.velocityNoise = velocityNoise;
+            self.headingNoise = headingNoise;
+            self.spreadUniformly(0.0);
+        }
+
+        /// Forgets the current estimate, for example when the car was put back onto the track somewhere else.
+        pub fn spreadUniformly(self: *Self, velocity: f32) void {
+            const step = self.trackLength / particleCount;
+            for (&self.distances, &self.velocities, &self.weights, 0..) |*distance, *particleVelocity, *weight, i| {
+                const iF32: f32 = @floatFromInt(i);
+                distance.* = iF32 * step;
+                particleVelocity.* = velocity;
+                weight.* = 1.0 / @as(f32, particleCount);
+            }
+            self.distance = 0.0;
+            self.velocity = velocity;
+            self.distanceVariance = self.trackLength * self.trackLength / 12.0;
+        }
+
+        /// measuredHeading is in degrees in the frame of the track.
+        pub fn update(self: *Self, measuredVelocity: f32, measuredHeading: f32, deltaTime: f32) linksection(placement.hotText("particleFilter.update")) void {
+            self.predict(measuredVelocity, deltaTime);
+            if (!self.weigh(measuredHeading)) {
+                // No particle explains the heading at all, keep the prediction instead of dividing by zero.
+                @memset(&self.weights, 1.0 / @as(f32, particleCount));
+            }
+            self.estimate(@mod(self.distance + self.velocity * deltaTime, self.trackLength));
+            if (self.effectiveParticleCount() < particleCount / 2) {
+                self.resample();
+            }
+        }
+
+        fn predict(self: *Self, measuredVelocity: f32, deltaTime: f32) linksection(placement.hotText("particleFilter.predict")) void {
+            const rng = self.prng.random();
+            for (&self.velocities) |*velocity| {
+                velocity.* = measuredVelocity + rng.floatNorm(f32) * self.velocityNoise;
+            }
+            const deltaTimeV: V = @splat(deltaTime);
+            const trackLengthV: V = @splat(self.trackLength);
+            var i: usize = 0;
+            while (i < particleCount) : (i += lanes) {
+                const distances: V = self.distances[i..][0..lanes].*;
+                const velocities: V = self.velocities[i..][0..lanes].*;
+                self.distances[i..][0..lanes].* = @mod(distances + velocities * deltaTimeV, trackLengthV);
+            }
+        }
+
+        /// Multiplies the weights with the gaussian likelihood of the heading error and normalizes them.
+        /// Returns false if all weights vanished.
+        fn weigh(self: *Self, measuredHeading: f32) linksection(placement.hotText("particleFilter.weigh")) bool {
+            const measuredV: V = @splat(measuredHeading);
+            const inverseNoiseV: V = @splat(1.0 / self.headingNoise);
+            var sumV: V = @splat(0.0);
+            var i: usize = 0;
+            while (i < particleCount) : (i += lanes) {
+                const distances: V = self.distances[i..][0..lanes].*;
+                const normalizedError = angularDeltaV(self.headingsAt(distances), measuredV) * inverseNoiseV;
+                const weights: V = self.weights[i..][0..lanes].*;
+                const newWeights = weights * @exp(normalizedError * normalizedError * @as(V, @splat(-0.5)));
+                self.weights[i..][0..lanes].* = newWeights;
+                sumV += newWeights;
+            }
+            const sum = @reduce(.Add, sumV);
+            if (!(sum > std.math.floatMin(f32)) or !std.math.isFinite(sum)) {
+                return false;
+            }
+            const inverseSumV: V = @splat(1.0 / sum);
+            i = 0;
+            while (i < particleCount) : (i += lanes) {
+                const weights: V = self.weights[i..][0..lanes].*;
+                self.weights[i..][0..lanes].* = weights * inverseSumV;
+            }
+            return true;
+        }
+
+        /// Weighted mean and variance of the distance, relative to the reference so the particles around
+        /// the start and the end of the track are averaged correctly.
+        fn estimate(self: *Self, reference: f32) linksection(placement.hotText("particleFilter.estimate")) void {
+            const referenceV: V = @splat(reference);
+            var meanV: V = @splat(0.0);
+            var squareV: V = @splat(0.0);
+            var velocityV: V = @splat(0.0);
+            var i: usize = 0;
+            while (i < particleCount) : (i += lanes) {
+                const distances: V = self.distances[i..][0..lanes].*;
+                const velocities: V = self.velocities[i..][0..lanes].*;
+                const weights: V = self.weights[i..][0..lanes].*;
+                const offsets = self.distanceDeltaV(referenceV, distances);
+                meanV += weights * offsets;
+                squareV += weights * offsets * offsets;
+                velocityV += weights * velocities;
+            }
+            const meanOffset = @reduce(.Add, meanV);
+            self.distance = @mod(reference + meanOffset, self.trackLength);
+            self.distanceVariance = @max(0.0, @reduce(.Add, squareV) - meanOffset * meanOffset);
+            self.velocity = @reduce(.Add, velocityV);
+        }
+
+        fn effectiveParticleCount(self: *const Self) f32 {
+            var squareV: V = @splat(0.0);
+            var i: usize = 0;
+            while (i < particleCount) : (i += lanes) {
+                const weights: V = self.weights[i..][0..lanes].*;
+                squareV += weights * weights;
+            }
+            return 1.0 / @reduce(.Add, squareV);
+        }
+
+        /// Systematic resampling, one random offset for all particles, so it is linear and keeps the particles
+        /// in proportion to their weights with the least variance.
+        fn resample(self: *Self) linksection(placement.hotText("particleFilter.resample")) void {
+            const step: f32 = 1.0 / @as(f32, particleCount);
+            var threshold = self.prng.random().float(f32) * step;
+            var cumulativeWeight = self.weights[0];
+            var source: usize = 0;
+            for (&self.resampledDistances, &self.resampledVelocities) |*distance, *velocity| {
+                while (threshold > cumulativeWeight and source < particleCount - 1) {
+                    source += 1;
+                    cumulativeWeight += self.weights[source];
+                }
+                distance.* = self.distances[source];
+                velocity.* = self.velocities[source];
+                threshold += step;
+            }
+            self.distances = self.resampledDistances;
+            self.velocities = self.resampledVelocities;
+            @memset(&self.weights, step);
+        }
+
+        pub fn headingAt(self: *const Self, distance: f32) f32 {
+            return self.headingsAt(@splat(distance))[0];
+        }
+
+        /// Linear interpolation in the heading table, across 360 to 0 the short way.
+        fn headingsAt(self: *const Self, distances: V) linksection(placement.hotText("particleFilter.headingsAt")) V {
+            const scaled = @max(distances * @as(V, @splat(headingTableSize / self.trackLength)), @as(V, @splat(0.0)));
+            const indices: IndexV = @min(@as(IndexV, @intFromFloat(scaled)), @as(IndexV, @splat(headingTableSize - 1)));
+            const fractions = scaled - @as(V, @floatFromInt(indices));
+            var before: V = undefined;
+            var after: V = undefined;
+            inline for (0..lanes) |lane| {
+                before[lane] = self.headingTable[indices[lane]];
+                after[lane] = self.headingTable[indices[lane] + 1];
+            }
+            return @mod(before + angularDeltaV(before, after) * fractions, @as(V, @splat(360.0)));
+        }
+
+        /// Same as Track.angularDelta, in [-180, 180).
+        fn angularDeltaV(from: V, to: V) V {
+            const delta = @mod(to - from, @as(V, @splat(360.0)));
+            return @select(f32, delta >= @as(V, @splat(180.0)), delta - @as(V, @splat(360.0)), delta);
+        }
+
+        /// Same as Track.distanceDelta, in [-trackLength / 2, trackLength / 2].
+        fn distanceDeltaV(self: *const Self, from: V, to: V) V {
+            const trackLengthV: V = @splat(self.trackLength);
+            const delta = @mod(to - from, trackLengthV);
+            return @select(f32, delta > trackLengthV * @as(V, @splat(0.5)), delta - trackLengthV, delta);
+        }
+    };
+}
+
+const testing = std.testing;
+const trackMod = @import("track");
+const Track = trackMod.Track(false);
+
+fn sineTrack(allocator: std.mem.Allocator) !Track {
+    return try trackMod.sineTrack.init(false, allocator, 721);
+}
+
+test "headingAtMatchesTrack" {
+    var track = try sineTrack(testing.allocator);
+    defer track.deinit();
+    const filter = try testing.allocator.create(ParticleFilter(64));
+    defer testing.allocator.destroy(filter);
+    filter.init(&track, 0, 0.05, 5.0);
+
+    for (0..100) |i| {
+        const distance = @as(f32, @floatFromInt(i)) * 0.0719;
+        const delta = Track.angularDelta(track.distanceToHeading(distance), filter.headingAt(distance));
+        try testing.expectApproxEqAbs(0.0, delta, 1.0);
+    }
+}
+
+test "convergesFromUniformSpread" {
+    var track = try sineTrack(testing.allocator);
+    defer track.deinit();
+    const filter = try testing.allocator.create(ParticleFilter(1024));
+    defer testing.allocator.destroy(filter);
+    filter.init(&track, 1, 0.05, 5.0);
+
+    var prng = std.Random.DefaultPrng.init(2);
+    const rng = prng.random();
+    const velocity: f32 = 1.5;
+    const deltaTime: f32 = 0.01;
+    var distance: f32 = 2.0;
+    for (0..400) |_| {
+        distance = @mod(distance + velocity * deltaTime, track.getTrackLength());
+        const measuredHeading = @mod(track.distanceToHeading(distance) + rng.floatNorm(f32) * 2.0, 360.0);
+        filter.update(velocity + rng.floatNorm(f32) * 0.05, measuredHeading, deltaTime);
+    }
+
+    try testing.expectApproxEqAbs(0.0, track.distanceDelta(distance, filter.distance), 0.1);
+    try testing.expect(filter.distanceVariance < 0.05);
+    try testing.expectApproxEqAbs(velocity, filter.velocity, 0.1);
+}
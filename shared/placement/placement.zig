@@ -0,0 +1,22 @@
+const builtin = @import("builtin");
+const options = @import("placementOptions");
+
+/// True when compiling for the esp and the control loop hot paths should not run from flash.
+pub const enabled = builtin.os.tag == .freestanding and options.hotPathsInIram;
+
+const defaultText = if (builtin.object_format == .macho) "__TEXT,__text" else ".text";
+
+/// Section for a function on the control path.
+/// The esp-idf linker script maps ".iram1.*" into IRAM, so these functions don't stall on
+/// instruction cache misses when WiFi evicts the flash cache.
+/// The name only shows up in the linker map (see "zig build placementReport").
+/// Only the functions themselves are placed, the soft-float and compiler-rt helpers they call stay in flash.
+pub fn hotText(comptime name: []const u8) []const u8 {
+    return if (enabled) ".iram1.asc." ++ name else defaultText;
+}
+
+/// hotText for generic code which is only on the control path for some of its types,
+/// the other instantiations stay in flash.
+pub fn hotTextIf(comptime hot: bool, comptime name: []const u8) []const u8 {
+    return if (hot) hotText(name) else defaultText;
+}
@@ -7,6 +7,11 @@ pub const CommandsEnum = enum(u8) {
     restart,
     endMapping,
     config,
+    getConfig,
+    applyConfig,
+    saveConfig,
+    subscribe,
+    ping,
 };
 
 pub const command = union(CommandsEnum) {
@@ -16,6 +21,11 @@ pub const command = union(CommandsEnum) {
     restart: restart,
     endMapping: endMapping,
     config: configMod.configCommand(),
+    getConfig: getConfig,
+    applyConfig: applyConfig,
+    saveConfig: saveConfig,
+    subscribe: subscribe,
+    ping: ping,
 };
 
 pub const setWifi = struct {
@@ -33,6 +43,26 @@ pub const setMode = struct {
 
 pub const restart = struct {};
 pub const endMapping = struct {};
+// Answered with a configSnapshot.
+pub const getConfig = struct {};
+// Replaces the whole config at once and stores it in the flash memory.
+pub const applyConfig = configMod.Config;
+// Stores the current config in the flash memory, so it is loaded at boot.
+pub const saveConfig = struct {};
+// Picks the telemetry streams of this connection and their rates in Hz, a stream which is left out is not sent at all.
+// A rate above the rate of the control loop sends every tick. Until the first subscribe the measurement
+// and the car track point are sent every tick.
+pub const subscribe = struct {
+    measurement: u16 = 0,
+    heading: u16 = 0,
+    acceleration: u16 = 0,
+    carTrackPoint: u16 = 0,
+};
+
+// Answered with a pong right away, to estimate the clock offset to the controller and the round trip time.
+pub const ping = struct {
+    clientMicros: i64,
+};
 
 pub const ServerContractEnum = enum(u8) {
     command,
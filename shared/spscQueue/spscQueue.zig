@@ -0,0 +1,87 @@
+const std = @import("std");
+
+/// Lock free queue for exactly one producer task and one consumer task.
+/// Only atomic loads and stores are used, so it works on cores without atomic read-modify-write instructions.
+pub fn SpscQueue(comptime T: type, comptime capacity: usize) type {
+    if (capacity == 0 or !std.math.isPowerOfTwo(capacity)) {
+        @compileError("capacity of a SpscQueue has to be a power of two.");
+    }
+    return struct {
+        const Self = @This();
+
+        buffer: [capacity]T,
+        head: std.atomic.Value(usize),
+        tail: std.atomic.Value(usize),
+
+        pub fn init() Self {
+            return .{
+                .buffer = undefined,
+                .head = std.atomic.Value(usize).init(0),
+                .tail = std.atomic.Value(usize).init(0),
+            };
+        }
+
+        /// Called by the producer. Returns false if the queue is full.
+        pub fn push(self: *Self, item: T) bool {
+            const tail = self.tail.raw;
+            if (tail -% self.head.load(.acquire) >= capacity) {
+                return false;
+            }
+            self.buffer[tail % capacity] = item;
+            self.tail.store(tail +% 1, .release);
+            return true;
+        }
+
+        /// Called by the consumer. Returns null if the queue is empty.
+        pub fn pop(self: *Self) ?T {
+            const head = self.head.raw;
+            if (head == self.tail.load(.acquire)) {
+                return null;
+            }
+            const item = self.buffer[head % capacity];
+            self.head.store(head +% 1, .release);
+            return item;
+        }
+    };
+}
+
+const testing = std.testing;
+
+test "pushAndPopInOrder" {
+    var queue = SpscQueue(u32, 4).init();
+    try testing.expectEqual(null, queue.pop());
+    for (0..4) |i| {
+        try testing.expect(queue.push(@intCast(i)));
+    }
+    try testing.expect(!queue.push(4));
+    try testing.expectEqual(0, queue.pop().?);
+    try testing.expect(queue.push(4));
+    for (1..5) |i| {
+        try testing.expectEqual(@as(u32, @intCast(i)), queue.pop().?);
+    }
+    try testing.expectEqual(null, queue.pop());
+}
+
+test "producerAndConsumerThread" {
+    const count = 100_000;
+    const Producer = struct {
+        fn run(queue: *SpscQueue(u32, 64)) void {
+            var i: u32 = 0;
+            while (i < count) {
+                if (queue.push(i)) {
+                    i += 1;
+                }
+            }
+        }
+    };
+    var queue = SpscQueue(u32, 64).init();
+    const thread = try std.Thread.spawn(.{}, Producer.run, .{&queue});
+    var expected: u32 = 0;
+    while (expected < count) {
+        if (queue.pop()) |item| {
+            try testing.expectEqual(expected, item);
+            expected += 1;
+        }
+    }
+    thread.join();
+}
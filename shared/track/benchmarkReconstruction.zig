@@ -0,0 +1,51 @@
+const std = @import("std");
+const trackMod = @import("track");
+const Track = trackMod.Track(false);
+const TrackPoint = trackMod.TrackPoint;
+
+const repetitions = 200;
+
+/// Returns the average microseconds of one reconstruction and the largest distance to the sequential positions.
+fn measure(allocator: std.mem.Allocator, trackPoints: []const TrackPoint, comptime reconstruct: anytype, reference: []const trackMod.DistancePosition) !struct { f64, f32 } {
+    var maxError: f32 = 0.0;
+    var timer = try std.time.Timer.start();
+    for (0..repetitions) |_| {
+        const distancePositions = try reconstruct(allocator, trackPoints);
+        defer allocator.free(distancePositions);
+        std.mem.doNotOptimizeAway(distancePositions.ptr);
+        for (distancePositions, reference) |distancePosition, expected| {
+            maxError = @max(maxError, @abs(distancePosition.position.x - expected.position.x), @abs(distancePosition.position.y - expected.position.y));
+        }
+    }
+    return .{ @as(f64, @floatFromInt(timer.read())) / repetitions / std.time.ns_per_us, maxError };
+}
+
+/// Compares the vectorized reconstruction of the track positions with the sequential one
+/// on the track of the positioning test, sampled ever denser.
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    var stdoutBuffer: [1024]u8 = undefined;
+    var stdoutWriter = std.fs.File.stdout().writer(&stdoutBuffer);
+    const writer = &stdoutWriter.interface;
+
+    for ([_]usize{ 721, 7201, 72001 }) |pointCount| {
+        const trackPoints = try trackMod.sineTrack.trackPoints(allocator, pointCount);
+        defer allocator.free(trackPoints);
+
+        const reference = try Track.trackPointsToDistancePositionsSequential(allocator, trackPoints);
+        defer allocator.free(reference);
+        const sequentialMicros, _ = try measure(allocator, trackPoints, Track.trackPointsToDistancePositionsSequential, reference);
+        const vectorizedMicros, const maxError = try measure(allocator, trackPoints, Track.trackPointsToDistancePositions, reference);
+        try writer.print("{d:>6} points: sequential {d:>9.1} us, vectorized {d:>9.1} us, speedup {d:.2}, max difference {e:.2} m\n", .{
+            pointCount,
+            sequentialMicros,
+            vectorizedMicros,
+            sequentialMicros / vectorizedMicros,
+            maxError,
+        });
+        try writer.flush();
+    }
+}
@@ -0,0 +1,203 @@
+const std = @import("std");
+const placement = @import("placement");
+
+/// The heading changes are sampled every sampleDistance meters of driven distance.
+pub const sampleDistance: f32 = 0.02;
+/// Number of heading changes in a window, it covers windowLength * sampleDistance meters.
+pub const windowLength = 64;
+// Heading changes are stored in hundredths of a degree, so the correlation is integer arithmetic (the esp has no FPU).
+const scale: f32 = 100.0;
+
+pub const Candidate = struct {
+    distance: f32,
+    // Normalized cross correlation of the window and the track at this distance, in [0, 1].
+    confidence: f32,
+};
+
+pub fn quantize(headingChange: f32) i16 {
+    return @intFromFloat(std.math.clamp(@round(headingChange * scale), -std.math.maxInt(i16), std.math.maxInt(i16)));
+}
+
+fn angularDelta(from: f32, to: f32) f32 {
+    var d = @mod(to - from, 360.0);
+    if (d >= 180.0) d -= 360.0;
+    return d;
+}
+
+/// The most recent heading changes of the car over its driven distance.
+/// Only changes are kept, so the drift of the integrated gyro heading doesn't matter.
+pub const HeadingWindow = struct {
+    const Self = @This();
+
+    samples: [windowLength]i16,
+    // Index of the oldest sample once the window is full.
+    next: usize,
+    count: usize,
+    lastDistance: f32,
+    lastHeading: f32,
+    // Distance driven since the last sample.
+    sinceLastSample: f32,
+    started: bool,
+
+    pub fn init() Self {
+        return .{
+            .samples = undefined,
+            .next = 0,
+            .count = 0,
+            .lastDistance = 0.0,
+            .lastHeading = 0.0,
+            .sinceLastSample = 0.0,
+            .started = false,
+        };
+    }
+
+    pub fn reset(self: *Self) void {
+        self.* = init();
+    }
+
+    /// distance is the driven distance in meters and heading the integrated heading in degrees.
+    pub fn update(self: *Self, distance: f32, heading: f32) linksection(placement.hotText("headingSignature.update")) void {
+        if (!self.started) {
+            self.lastDistance = distance;
+            self.lastHeading = heading;
+            self.started = true;
+            return;
+        }
+        self.sinceLastSample = distance - self.lastDistance;
+        if (self.sinceLastSample < sampleDistance) {
+            return;
+        }
+        // Spread over the samples if more than one was driven in a tick.
+        const steps: usize = @intFromFloat(self.sinceLastSample / sampleDistance);
+        const sample = quantize(angularDelta(self.lastHeading, heading) / @as(f32, @floatFromInt(steps)));
+        for (0..@min(steps, windowLength)) |_| {
+            self.samples[self.next] = sample;
+            self.next = (self.next + 1) % windowLength;
+            self.count = @min(self.count + 1, windowLength);
+        }
+        self.lastDistance += @as(f32, @floatFromInt(steps)) * sampleDistance;
+        self.lastHeading = heading;
+        self.sinceLastSample = distance - self.lastDistance;
+    }
+
+    pub fn isFull(self: *const Self) bool {
+        return self.count == windowLength;
+    }
+
+    /// The samples from the oldest to the newest.
+    pub fn ordered(self: *const Self) [windowLength]i16 {
+        var samples: [windowLength]i16 = undefined;
+        for (&samples, 0..) |*sample, i| {
+            sample.* = self.samples[(self.next + i) % windowLength];
+        }
+        return samples;
+    }
+};
+
+/// The heading changes of a track every sampleDistance from distance 0, followed by the first windowLength - 1
+/// samples again so windows across the end of the track don't have to wrap.
+/// energy[i] is the sum of the squares of the first i samples.
+pub const Signature = struct {
+    const Self = @This();
+
+    samples: []i16,
+    energy: []i64,
+    sampleCount: usize,
+    trackLength: f32,
+
+    /// track needs getTrackLength and distanceToHeading, it is only read here.
+    pub fn init(allocator: std.mem.Allocator, track: anytype) !Self {
+        const trackLength = track.getTrackLength();
+        const sampleCount: usize = @intFromFloat(trackLength / sampleDistance);
+        if (sampleCount < windowLength) {
+            return .{ .samples = &.{}, .energy = &.{}, .sampleCount = 0, .trackLength = trackLength };
+        }
+        const samples = try allocator.alloc(i16, sampleCount + windowLength - 1);
+        errdefer allocator.free(samples);
+        const energy = try allocator.alloc(i64, samples.len + 1);
+
+        var prevHeading = track.distanceToHeading(0.0);
+        for (0..sampleCount) |i| {
+            const distance = @mod(@as(f32, @floatFromInt(i + 1)) * sampleDistance, trackLength);
+            const heading = track.distanceToHeading(distance);
+            samples[i] = quantize(angularDelta(prevHeading, heading));
+            prevHeading = heading;
+        }
+        @memcpy(samples[sampleCount..], samples[0 .. windowLength - 1]);
+        energy[0] = 0;
+        for (samples, 0..) |sample, i| {
+            energy[i + 1] = energy[i] + @as(i64, sample) * sample;
+        }
+        return .{ .samples = samples, .energy = energy, .sampleCount = sampleCount, .trackLength = trackLength };
+    }
+
+    fn score(self: *const Self, window: *const [windowLength]i16, windowEnergy: i64, start: usize) linksection(placement.hotText("headingSignature.score")) f32 {
+        const segmentEnergy = self.energy[start + windowLength] - self.energy[start];
+        if (segmentEnergy == 0) {
+            return 0.0;
+        }
+        var dot: i64 = 0;
+        for (window, self.samples[start..][0..windowLength]) |a, b| {
+            dot += @as(i32, a) * b;
+        }
+        const denominator = @sqrt(@as(f32, @floatFromInt(windowEnergy)) * @as(f32, @floatFromInt(segmentEnergy)));
+        return @max(0.0, @as(f32, @floatFromInt(dot)) / denominator);
+    }
+
+    /// Slides the window over the whole track and writes the local maxima of the normalized cross correlation
+    /// with the highest confidence into candidates, sorted by confidence.
+    /// The distance of a candidate is where the car is now, at the end of the window.
+    /// Nothing is found if the window isn't full or only contains straights.
+    pub fn match(self: *const Self, headingWindow: *const HeadingWindow, candidates: []Candidate) linksection(placement.hotText("headingSignature.match")) []Candidate {
+        if (self.sampleCount == 0 or !headingWindow.isFull() or candidates.len == 0) {
+            return candidates[0..0];
+        }
+        const window = headingWindow.ordered();
+        var windowEnergy: i64 = 0;
+        for (window) |sample| {
+            windowEnergy += @as(i64, sample) * sample;
+        }
+        if (windowEnergy == 0) {
+            return candidates[0..0];
+        }
+
+        var count: usize = 0;
+        const first = self.score(&window, windowEnergy, 0);
+        var prev = self.score(&window, windowEnergy, self.sampleCount - 1);
+        var current = first;
+        for (0..self.sampleCount) |start| {
+            const next = if (start + 1 < self.sampleCount) self.score(&window, windowEnergy, start + 1) else first;
+            if (current > 0.0 and current >= prev and current > next) {
+                const endDistance = @as(f32, @floatFromInt(start + windowLength)) * sampleDistance + headingWindow.sinceLastSample;
+                insertSorted(candidates, &count, .{ .distance = @mod(endDistance, self.trackLength), .confidence = current });
+            }
+            prev = current;
+            current = next;
+        }
+        return candidates[0..count];
+    }
+
+    fn insertSorted(candidates: []Candidate, count: *usize, candidate: Candidate) void {
+        var i = count.*;
+        if (i == candidates.len) {
+            if (candidate.confidence <= candidates[i - 1].confidence) {
+                return;
+            }
+            i -= 1;
+        } else {
+            count.* += 1;
+        }
+        while (i > 0 and candidates[i - 1].confidence < candidate.confidence) : (i -= 1) {
+            candidates[i] = candidates[i - 1];
+        }
+        candidates[i] = candidate;
+    }
+
+    pub fn deinit(self: *Self, allocator: std.mem.Allocator) void {
+        if (self.sampleCount == 0) {
+            return;
+        }
+        allocator.free(self.samples);
+        allocator.free(self.energy);
+    }
+};
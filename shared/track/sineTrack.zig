@@ -0,0 +1,35 @@
+const std = @import("std");
+const trackMod = @import("track.zig");
+const TrackPoint = trackMod.TrackPoint;
+
+/// The track of the positioning test, the tests and the benchmarks.
+/// The heading is a sine with an amplitude of 150 degrees and a period of 3.6 m,
+/// so every heading except the extremes appears twice per period.
+pub const length = 7.2;
+const period = 3.6;
+
+/// The heading in degrees at the distance in meters, scalarT is f32 or f64.
+pub fn heading(comptime scalarT: type, meters: scalarT) scalarT {
+    return @mod(@sin(meters / period * 2 * std.math.pi) * 150 + 360, 360);
+}
+
+/// The distance of the point at index when the track is sampled with pointCount points, the first at 0 and the last at length.
+pub fn distance(comptime scalarT: type, index: usize, pointCount: usize) scalarT {
+    return @as(scalarT, @floatFromInt(index)) * length / @as(scalarT, @floatFromInt(pointCount - 1));
+}
+
+/// The caller owns the returned track points.
+pub fn trackPoints(allocator: std.mem.Allocator, pointCount: usize) ![]TrackPoint {
+    const points = try allocator.alloc(TrackPoint, pointCount);
+    for (points, 0..) |*point, i| {
+        const meters = distance(f32, i, pointCount);
+        point.* = .{ .distance = meters, .heading = heading(f32, meters) };
+    }
+    return points;
+}
+
+pub fn init(comptime buildKdTree: bool, allocator: std.mem.Allocator, pointCount: usize) !trackMod.Track(buildKdTree) {
+    const points = try trackPoints(allocator, pointCount);
+    errdefer allocator.free(points);
+    return try trackMod.Track(buildKdTree).init(allocator, points);
+}
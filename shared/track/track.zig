@@ -5,6 +5,11 @@ const KdTree = kdTreeMod.KdTree(TrackPoint, 2);
 const icpMod = @import("icp");
 const Icp = icpMod.Icp(TrackPoint);
 const matrix = @import("matrix");
+const placement = @import("placement");
+const headingSignature = @import("headingSignature.zig");
+pub const HeadingWindow = headingSignature.HeadingWindow;
+pub const RelocalizationCandidate = headingSignature.Candidate;
+pub const sineTrack = @import("sineTrack.zig");
 
 pub const Position = struct {
     x: f32,
@@ -18,6 +23,9 @@ pub const DistancePosition = struct {
 
 
 pub fn Track(comptime buildKdTree: bool) type {
+    const lanes = std.simd.suggestVectorLength(f32) orelse 4;
+    const V = @Vector(lanes, f32);
+
     return struct {
         const Self = @This();
 
@@ -25,6 +33,8 @@ pub fn Track(comptime buildKdTree: bool) type {
         trackPoints: []const TrackPoint,
         distancePositions: []const DistancePosition,
         kdTree: KdTree,
+        // Heading changes of the whole track, to find where a window of recent heading changes was driven.
+        headingSignature: headingSignature.Signature,
 
         pub fn init(allocator: std.mem.Allocator, trackPoints: []TrackPoint) !Self {
             if (trackPoints.len < 3) {
@@ -45,20 +55,89 @@ pub fn Track(comptime buildKdTree: bool) type {
             }
 
             const kdTree = try KdTree.init(allocator, if (buildKdTree) trackPoints else &.{});
+            errdefer kdTree.deinit();
             std.mem.sort(TrackPoint, trackPoints, {},  struct {
                 fn lessThan(_: void, a: TrackPoint, b: TrackPoint) bool {
                     return a.distance < b.distance;
                 }
             }.lessThan);
-            return .{
+            const distancePositions = try trackPointsToDistancePositions(allocator, trackPoints);
+            errdefer allocator.free(distancePositions);
+            var track: Self = .{
                 .allocator = allocator,
                 .trackPoints = trackPoints,
-                .distancePositions = try trackPointsToDistancePositions(allocator, trackPoints),
+                .distancePositions = distancePositions,
                 .kdTree = kdTree,
+                .headingSignature = undefined,
             };
+            track.headingSignature = try headingSignature.Signature.init(allocator, track);
+            return track;
         }
 
+        /// Integrates the headings to positions with Simpson's rule over every two segments, the first segment is
+        /// integrated on its own with its average heading if the count of segments is odd.
+        /// The displacements of all integration steps are independent of each other, so they are computed with @Vector
+        /// trigonometry and the positions are their prefix sums.
         pub fn trackPointsToDistancePositions(allocator: std.mem.Allocator, trackPoints: []const TrackPoint) ![]DistancePosition {
+            const separateCount = (trackPoints.len - 1) % 2;
+            const stepCount = separateCount + (trackPoints.len - 1) / 2;
+            // Padded to whole vectors, the padding has no length and so no displacement.
+            const paddedCount = std.mem.alignForward(usize, stepCount, lanes);
+            const scratch = try allocator.alloc(f32, 6 * paddedCount);
+            defer allocator.free(scratch);
+            const startHeadings = scratch[0 * paddedCount .. 1 * paddedCount];
+            const midHeadings = scratch[1 * paddedCount .. 2 * paddedCount];
+            const endHeadings = scratch[2 * paddedCount .. 3 * paddedCount];
+            const lengths = scratch[3 * paddedCount .. 4 * paddedCount];
+            const xs = scratch[4 * paddedCount .. 5 * paddedCount];
+            const ys = scratch[5 * paddedCount .. 6 * paddedCount];
+            @memset(scratch[0 .. 4 * paddedCount], 0.0);
+
+            if (separateCount != 0) {
+                // Simpson's rule with the same heading at both ends and the middle is the rectangle with that heading.
+                const averageHeading = (trackPoints[1].heading + trackPoints[0].heading) / 2.0;
+                startHeadings[0] = averageHeading;
+                midHeadings[0] = averageHeading;
+                endHeadings[0] = averageHeading;
+                lengths[0] = trackPoints[1].distance - trackPoints[0].distance;
+            }
+            for (separateCount..stepCount) |step| {
+                const i = 2 * step - separateCount;
+                startHeadings[step] = trackPoints[i].heading;
+                midHeadings[step] = midHeading(trackPoints[i..][0..3]);
+                endHeadings[step] = trackPoints[i + 2].heading;
+                lengths[step] = trackPoints[i + 2].distance - trackPoints[i].distance;
+            }
+
+            const toRadians: V = @splat(std.math.pi / 180.0);
+            const four: V = @splat(4.0);
+            const sixth: V = @splat(1.0 / 6.0);
+            var i: usize = 0;
+            while (i < paddedCount) : (i += lanes) {
+                const start: V = startHeadings[i..][0..lanes].*;
+                const mid: V = midHeadings[i..][0..lanes].*;
+                const end: V = endHeadings[i..][0..lanes].*;
+                const weightedLengths = @as(V, lengths[i..][0..lanes].*) * sixth;
+                const startRadians = start * toRadians;
+                const midRadians = mid * toRadians;
+                const endRadians = end * toRadians;
+                xs[i..][0..lanes].* = -weightedLengths * (@cos(startRadians) + four * @cos(midRadians) + @cos(endRadians));
+                ys[i..][0..lanes].* = weightedLengths * (@sin(startRadians) + four * @sin(midRadians) + @sin(endRadians));
+            }
+            prefixSum(xs);
+            prefixSum(ys);
+
+            const distancePositions = try allocator.alloc(DistancePosition, stepCount + 1);
+            distancePositions[0] = .{ .distance = 0.0, .position = .{ .x = 0.0, .y = 0.0 } };
+            for (distancePositions[1..], xs[0..stepCount], ys[0..stepCount], 0..) |*distancePosition, x, y, step| {
+                distancePosition.* = .{ .distance = trackPoints[2 * step + 2 - separateCount].distance, .position = .{ .x = x, .y = y } };
+            }
+            return distancePositions;
+        }
+
+        /// The same integration one step after the other with scalar trigonometry.
+        /// It is the reference for trackPointsToDistancePositions in the tests and the benchmark.
+        pub fn trackPointsToDistancePositionsSequential(allocator: std.mem.Allocator, trackPoints: []const TrackPoint) ![]DistancePosition {
             var distancePositions = try std.ArrayList(DistancePosition).initCapacity(allocator, @divTrunc(trackPoints.len, 2) + 5);
             var prevPosition: Position = .{.x = 0.0, .y = 0.0};
             try distancePositions.append(allocator, .{.distance = 0.0, .position = prevPosition});
@@ -79,31 +158,18 @@ pub fn Track(comptime buildKdTree: bool) type {
                 prevPosition = currentPosition;
             }
 
-            for (countPointsNeedingSeperateHandling..trackPoints.len - 2) |i| {
+            var i = countPointsNeedingSeperateHandling;
+            while (i + 2 < trackPoints.len) : (i += 2) {
                 const diffDistance = trackPoints[i + 2].distance - trackPoints[i].distance;
-
-                const midDistance = trackPoints[i].distance + (trackPoints[i + 2].distance - trackPoints[i].distance) / 2;
-
-                var beforeMid: TrackPoint = undefined;
-                var afterMid: TrackPoint = undefined;
-                if (trackPoints[i].distance <= midDistance and midDistance <= trackPoints[i + 1].distance) {
-                    beforeMid = trackPoints[i];
-                    afterMid = trackPoints[i + 1];
-
-                } else {
-                    beforeMid = trackPoints[i + 1];
-                    afterMid = trackPoints[i + 2];
-                }
-
-                const midHeading = beforeMid.heading + angularDelta(beforeMid.heading, afterMid.heading) * (midDistance -  beforeMid.distance) / (afterMid.distance - beforeMid.distance);
+                const midHeadingValue = midHeading(trackPoints[i..][0..3]);
                 
                 const xFa = -std.math.cos(trackPoints[i].heading * std.math.pi / 180.0);
-                const xFab = -std.math.cos(midHeading * std.math.pi / 180.0);
+                const xFab = -std.math.cos(midHeadingValue * std.math.pi / 180.0);
                 const xFb = -std.math.cos(trackPoints[i + 2].heading * std.math.pi / 180.0);
                 const xDiff = diffDistance / 6.0 * (xFa + 4 * xFab + xFb);
 
                 const yFa = std.math.sin(trackPoints[i].heading * std.math.pi / 180.0);
-                const yFab = std.math.sin(midHeading * std.math.pi / 180.0);
+                const yFab = std.math.sin(midHeadingValue * std.math.pi / 180.0);
                 const yFb = std.math.sin(trackPoints[i + 2].heading * std.math.pi / 180.0);
                 const yDiff = diffDistance / 6.0 * (yFa + 4 * yFab + yFb);
 
@@ -117,12 +183,57 @@ pub fn Track(comptime buildKdTree: bool) type {
             return try distancePositions.toOwnedSlice(allocator);
         }
 
-        pub fn getTrackLength(self: Self) f32 {
+        /// The heading halfway between the first and the last of three track points.
+        fn midHeading(trackPoints: *const [3]TrackPoint) f32 {
+            const midDistance = trackPoints[0].distance + (trackPoints[2].distance - trackPoints[0].distance) / 2;
+
+            var beforeMid: TrackPoint = undefined;
+            var afterMid: TrackPoint = undefined;
+            if (trackPoints[0].distance <= midDistance and midDistance <= trackPoints[1].distance) {
+                beforeMid = trackPoints[0];
+                afterMid = trackPoints[1];
+
+            } else {
+                beforeMid = trackPoints[1];
+                afterMid = trackPoints[2];
+            }
+
+            return beforeMid.heading + angularDelta(beforeMid.heading, afterMid.heading) * (midDistance -  beforeMid.distance) / (afterMid.distance - beforeMid.distance);
+        }
+
+        /// Inclusive prefix sum in place, values.len has to be a multiple of lanes.
+        /// Within a vector the sum is built in log2(lanes) shifted additions, the vectors are chained by their last lane.
+        fn prefixSum(values: []f32) void {
+            const zero: V = @splat(0.0);
+            var carry: f32 = 0.0;
+            var i: usize = 0;
+            while (i < values.len) : (i += lanes) {
+                var sums: V = values[i..][0..lanes].*;
+                comptime var shift = 1;
+                inline while (shift < lanes) : (shift *= 2) {
+                    sums += @shuffle(f32, sums, zero, comptime shiftMask(shift));
+                }
+                sums += @as(V, @splat(carry));
+                values[i..][0..lanes].* = sums;
+                carry = sums[lanes - 1];
+            }
+        }
+
+        /// Moves every lane shift lanes up and fills the lowest lanes from the zero vector.
+        fn shiftMask(shift: usize) @Vector(lanes, i32) {
+            var mask: [lanes]i32 = undefined;
+            for (&mask, 0..) |*index, lane| {
+                index.* = if (lane >= shift) @intCast(lane - shift) else -1;
+            }
+            return mask;
+        }
+
+        pub fn getTrackLength(self: Self) linksection(placement.hotText("track.getTrackLength")) f32 {
             return self.trackPoints[self.trackPoints.len - 1].distance;
         }
 
         // TODO: maybe use binary search
-        pub fn distanceToHeading(self: Self, distance: f32) f32 {
+        pub fn distanceToHeading(self: Self, distance: f32) linksection(placement.hotText("track.distanceToHeading")) f32 {
             const lastPoint = self.trackPoints[self.trackPoints.len - 1];
             if (distance > lastPoint.distance) {
                 @panic("distance can never be greater than last point");
@@ -135,7 +246,7 @@ pub fn Track(comptime buildKdTree: bool) type {
             @panic("distance could not be converted to heading");
         }
 
-        pub fn distanceToHeadingDerivative(self: Self, distance: f32) f32 {
+        pub fn distanceToHeadingDerivative(self: Self, distance: f32) linksection(placement.hotText("track.distanceToHeadingDerivative")) f32 {
             const lastPoint = self.trackPoints[self.trackPoints.len - 1];
             if (distance > lastPoint.distance) {
                 @panic("distance can never be greater than last point");
@@ -165,7 +276,7 @@ pub fn Track(comptime buildKdTree: bool) type {
             @panic("distance could not be converted to position");
         }
 
-        pub fn minDifferenceDistances(self: Self, a: f32, b: f32) f32 {
+        pub fn minDifferenceDistances(self: Self, a: f32, b: f32) linksection(placement.hotText("track.minDifferenceDistances")) f32 {
             const d = @abs(a - b);
             return @min(d, @max(0, self.getTrackLength() - d));
         }
@@ -180,12 +291,12 @@ pub fn Track(comptime buildKdTree: bool) type {
             return diff;
         }
 
-        pub fn minDifferenceAngle(a: f32, b: f32) f32 {
+        pub fn minDifferenceAngle(a: f32, b: f32) linksection(placement.hotText("track.minDifferenceAngle")) f32 {
             const d = @abs(a - b);
             return @min(d, 360.0 - d);
         }
 
-        pub fn angularDelta(from: f32, to: f32) f32 {
+        pub fn angularDelta(from: f32, to: f32) linksection(placement.hotText("track.angularDelta")) f32 {
             var d = @mod(to - from, 360.0);
             if (d >= 180.0) d -= 360.0;
             return d;
@@ -225,14 +336,14 @@ pub fn Track(comptime buildKdTree: bool) type {
             return closest.?;
         }
 
-        pub fn getClosestPoint(self: Self, point: TrackPoint) TrackPoint {
+        pub fn getClosestPoint(self: Self, point: TrackPoint) linksection(placement.hotText("track.getClosestPoint")) TrackPoint {
             if (!buildKdTree) {
                 @compileError("Getting closest point is not implemented when kdTree is not built.");
             }
             return self.kdTree.nearestNeighbor(point).?;
         }
 
-        fn projectTrackPoint(self: Self, from: TrackPoint, to: TrackPoint, toProject: TrackPoint) TrackPoint {
+        fn projectTrackPoint(self: Self, from: TrackPoint, to: TrackPoint, toProject: TrackPoint) linksection(placement.hotText("track.projectTrackPoint")) TrackPoint {
             const direction: [2]f32 = .{ 
                 to.distance - from.distance, 
                 angularDelta(from.heading, to.heading) / 100.0
@@ -252,7 +363,7 @@ pub fn Track(comptime buildKdTree: bool) type {
             };
         }
 
-        pub fn getClosestPointInterpolated(self: Self, point: TrackPoint) TrackPoint {
+        pub fn getClosestPointInterpolated(self: Self, point: TrackPoint) linksection(placement.hotText("track.getClosestPointInterpolated")) TrackPoint {
             const closest: TrackPoint = self.getClosestPoint(point);
 
             const compareFn = struct {
@@ -285,13 +396,21 @@ pub fn Track(comptime buildKdTree: bool) type {
                 @compileError("Getting icp offset is not implemented when kdTree is not built.");
             }
             const icp = Icp.init(points, &self.kdTree, 3);
-            return @floatCast(icp.icp());
+            return icp.icp();
+        }
+
+        /// Global relocalization without an approximate distance, for example after the car deslotted.
+        /// Writes the distances where the recent heading changes of the car match the track best into candidates,
+        /// sorted by confidence. Returns nothing until the window is full or if it only contains straights.
+        pub fn relocalize(self: *const Self, headingWindow: *const HeadingWindow, candidates: []RelocalizationCandidate) linksection(placement.hotText("track.relocalize")) []RelocalizationCandidate {
+            return self.headingSignature.match(headingWindow, candidates);
         }
 
         pub fn deinit(self: *Self) void {
             self.allocator.free(self.trackPoints);
             self.allocator.free(self.distancePositions);
             self.kdTree.deinit();
+            self.headingSignature.deinit(self.allocator);
         }
     };
 }
@@ -414,3 +533,65 @@ test "getClosestPointInterpolated" {
         try std.testing.expectApproxEqAbs(0.45544553, result.distance, 1e-6);
     }
 }
+
+test "relocalize" {
+    const allocator = std.testing.allocator;
+
+    var track = try sineTrack.init(false, allocator, 721);
+    defer track.deinit();
+
+    var headingWindow = HeadingWindow.init();
+    var candidates: [3]RelocalizationCandidate = undefined;
+    // The integrated heading of the car is offset to the track, only its changes are matched.
+    const headingOffset: f32 = 37.0;
+    const odometerOffset: f32 = 12.3;
+    for (150..311) |i| {
+        const distance = @as(f32, @floatFromInt(i)) * 0.01;
+        if (i < 250) {
+            // The window covers 1.28 m.
+            try std.testing.expectEqual(0, track.relocalize(&headingWindow, &candidates).len);
+        }
+        headingWindow.update(odometerOffset + distance, @mod(track.distanceToHeading(distance) + headingOffset, 360));
+    }
+
+    const found = track.relocalize(&headingWindow, &candidates);
+    try std.testing.expect(found.len > 0);
+    try std.testing.expectApproxEqAbs(3.1, found[0].distance, 0.03);
+    try std.testing.expect(found[0].confidence > 0.95);
+    for (found[1..]) |candidate| {
+        try std.testing.expect(candidate.confidence <= found[0].confidence);
+    }
+}
+
+test "trackPointsToDistancePositions" {
+    const allocator = std.testing.allocator;
+
+    // A circle, odd and even counts of segments take different paths for the first segment.
+    for ([_]usize{ 720, 721 }) |pointCount| {
+        const trackPoints = try allocator.alloc(TrackPoint, pointCount);
+        defer allocator.free(trackPoints);
+        const trackLength: f32 = 7.2;
+        const radius = trackLength / (2.0 * std.math.pi);
+        for (trackPoints, 0..) |*trackPoint, i| {
+            const iF32: f32 = @floatFromInt(i);
+            const countF32: f32 = @floatFromInt(pointCount);
+            trackPoint.* = .{ .distance = iF32 * trackLength / countF32, .heading = iF32 * 360.0 / countF32 };
+        }
+
+        const distancePositions = try Track(false).trackPointsToDistancePositions(allocator, trackPoints);
+        defer allocator.free(distancePositions);
+        const sequential = try Track(false).trackPointsToDistancePositionsSequential(allocator, trackPoints);
+        defer allocator.free(sequential);
+
+        try std.testing.expectEqual(sequential.len, distancePositions.len);
+        for (distancePositions, sequential) |distancePosition, expected| {
+            try std.testing.expectEqual(expected.distance, distancePosition.distance);
+            try std.testing.expectApproxEqAbs(expected.position.x, distancePosition.position.x, 1e-4);
+            try std.testing.expectApproxEqAbs(expected.position.y, distancePosition.position.y, 1e-4);
+
+            const angle = distancePosition.distance / radius;
+            try std.testing.expectApproxEqAbs(-radius * @sin(angle), distancePosition.position.x, 1e-3);
+            try std.testing.expectApproxEqAbs(radius * (1.0 - @cos(angle)), distancePosition.position.y, 1e-3);
+        }
+    }
+}
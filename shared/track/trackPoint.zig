@@ -1,4 +1,5 @@
 const Track = @import("track.zig").Track(false);
+const placement = @import("placement");
 
 pub const TrackPoint = struct {
     distance: f32,
@@ -6,36 +7,39 @@ pub const TrackPoint = struct {
 
     const Self = @This();
 
-    pub fn init(distance: f64, heading: f64) Self {
+    // The kd tree of the track is searched in the control loop, see KdTree.
+    pub const onControlPath = true;
+
+    pub fn init(distance: f32, heading: f32) Self {
         return .{
-            .distance = @floatCast(distance),
-            .heading = @floatCast(heading),
+            .distance = distance,
+            .heading = heading,
         };
     }
 
-    pub fn getX(self: Self) f64 {
-        return @floatCast(self.distance);
+    pub fn getX(self: Self) f32 {
+        return self.distance;
     }
 
-    pub fn getY(self: Self) f64 {
-        return @floatCast(self.heading);
+    pub fn getY(self: Self) f32 {
+        return self.heading;
     }
 
 
     // TODO: distanceNoRoot has to know the trackLength
-    pub fn minDifferenceDistances(a: f32, b: f32) f32 {
+    pub fn minDifferenceDistances(a: f32, b: f32) linksection(placement.hotText("trackPoint.minDifferenceDistances")) f32 {
         const d = @abs(a - b);
         return @min(d, @max(0, 7.21 - d));
     }
 
-    pub fn distanceNoRoot(self: Self, point: Self) f64 {
+    pub fn distanceNoRoot(self: Self, point: Self) linksection(placement.hotText("trackPoint.distanceNoRoot")) f32 {
         const distanceDiff = minDifferenceDistances(point.distance, self.distance);
         var headingDiff = Track.minDifferenceAngle(point.heading, self.heading);
         headingDiff *= 0.01;
         return distanceDiff * distanceDiff + headingDiff * headingDiff;
     }
 
-    pub fn getDimension(self: Self, dimension: usize) f64 {
+    pub fn getDimension(self: Self, dimension: usize) linksection(placement.hotText("trackPoint.getDimension")) f32 {
         if (dimension == 0) {
             return self.distance;
         } else if (dimension == 1) {